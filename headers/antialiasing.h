@@ -0,0 +1,19 @@
+#ifndef ANTIALIASING_INCLUDED
+#define ANTIALIASING_INCLUDED
+
+#include "mandelbrot.h"
+
+// subsamples grid side, every edge pixel is replaced by AA_GRID_SIZE^2 jittered subsamples
+const uint32_t AA_GRID_SIZE = 3;
+
+// pixel is an edge one if its num differs from one of its neighbors more than this value
+const uint32_t AA_NUM_THRESHOLD = 2;
+
+// number of edge pixels calculated by one calcMandelbrotPoints call
+const size_t AA_BATCH_PIXELS = 64;
+
+/// @brief adaptive supersampling: adds jittered subsamples only to pixels on the edges,
+///        md->num_pixels and md->color_pixels must be already calculated, returns number of edge pixels
+size_t antialiasMandelbrot(mandelbrot_context_t * md, const size_t threads_num);
+
+#endif
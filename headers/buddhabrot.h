@@ -0,0 +1,43 @@
+#ifndef BUDDHABROT_INCLUDED
+#define BUDDHABROT_INCLUDED
+
+#include "mandelbrot.h"
+
+// number of samples (or Metropolis chains) checked for escaping by one calcMandelbrotPoints call
+const size_t BUDDHA_BATCH_SIZE = 256;
+
+// orbits shorter than this do not get into the histogram (they only blur the picture)
+const uint32_t BUDDHA_MIN_ITER_NUM = 20;
+
+// iteration limits of red, green and blue channels of Nebulabrot
+const uint32_t NEBULA_ITER_NUMS[3] = {5000, 500, 50};
+
+// Metropolis sampling: probability of the new uniform sample instead of mutation of the current one
+const float METROPOLIS_UNIFORM_PROB = 0.2f;
+
+// Metropolis sampling: standard deviation of small mutation in the view widths
+const float METROPOLIS_MUTATION_SIGMA = 0.05f;
+
+typedef struct {
+    size_t samples_num;     // number of sampled c in all threads
+    size_t threads_num;
+
+    bool is_nebula;         // three channels with NEBULA_ITER_NUMS limits, otherwise one channel with md->iter_num
+    bool is_metropolis;     // importance sampling of c, otherwise c are sampled uniformly
+} buddhabrot_params_t;
+
+typedef struct {
+    size_t samples;         // checked c
+    size_t orbits;          // escaped orbits replayed into the histogram
+    size_t points;          // orbit points which got into the view
+
+    double time;            // in ms
+    double orbits_per_sec;
+} buddhabrot_stats_t;
+
+/// @brief renders density of escaping orbits into md->color_pixels (md->num_pixels are used for tone mapped density):
+///        samples are checked for escaping by SIMD kernel in batches, then escaped orbits are replayed
+///        into per-thread histograms, which are merged and tone mapped in the end
+buddhabrot_stats_t renderBuddhabrot(mandelbrot_context_t * md, const buddhabrot_params_t * params);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef DISTRIBUTED_INCLUDED
+#define DISTRIBUTED_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "mandelbrot.h"
+
+const size_t MAX_WORKERS_NUM = 64;
+
+// frame is divided into tiles of this number of rows, tiles are given to workers one by one
+const uint32_t DIST_TILE_ROWS = 16;
+
+// number of tiles sent to one worker before it answers (so it does not wait for the next one)
+const size_t WORKER_PIPELINE_DEPTH = 2;
+
+// when no tiles are left, a tile running longer than this number of mean tile times is given to an idle worker too
+const double SPECULATION_COEF = 3.;
+
+// worker which has not answered for this time is considered dead, its tiles are given to others
+const double WORKER_TIMEOUT_MS = 10000.;
+
+// coordinator waits for this time for min_workers_num workers to connect
+const double CONNECT_TIMEOUT_MS = 10000.;
+
+// widest frame rendered by workers (bigger requests are taken for corrupted ones)
+const uint32_t MAX_DIST_WIDTH = 1 << 16;
+
+typedef struct {
+    uint16_t port;                  // 0 - any free port (it is enough for local workers)
+    const char * bind_address;      // NULL - loopback only, remote workers need address of an interface or "0.0.0.0"
+
+    size_t local_workers_num;       // worker processes started on this host
+    const char * worker_path;       // local workers are run as "worker_path -w 127.0.0.1 port" (main.cpp handles -w),
+                                    // NULL - the running program itself
+    size_t min_workers_num;         // rendering is not started before this number of workers is connected
+
+    // called for every tile as soon as it is in context.num_pixels (tiles come in any order)
+    void (*tile_callback)(const mandelbrot_context_t * md, uint32_t row_begin, uint32_t row_end, void * arg);
+    void * callback_arg;
+} coordinator_params_t;
+
+typedef struct {
+    char name[32];                  // address of the worker
+
+    size_t tiles;                   // tiles which results were used
+    size_t pixels;
+    double busy_time;               // in ms, calculation time reported by the worker
+
+    bool is_dead;
+} worker_stats_t;
+
+typedef struct {
+    worker_stats_t workers[MAX_WORKERS_NUM];
+    size_t workers_num;
+
+    size_t tiles;
+    size_t retried_tiles;           // tiles of dead workers given to others
+    size_t speculative_tiles;       // copies of slow tiles given to idle workers
+
+    double time;                    // in ms
+} coordinator_stats_t;
+
+typedef struct coordinator coordinator_t;
+
+/// @brief starts listening on params.port of params.bind_address and spawns local worker processes
+coordinator_t * coordinatorCtor(const coordinator_params_t * params);
+
+/// @brief port the coordinator listens on (for remote workers)
+uint16_t coordinatorPort(const coordinator_t * coord);
+
+/// @brief renders frame of md into md->num_pixels by workers, workers stay connected for next frames;
+///        returns false if all workers died before the frame was rendered
+bool coordinatorRender(coordinator_t * coord, mandelbrot_context_t * md, coordinator_stats_t * stats);
+
+/// @brief disconnects workers and waits for local ones to exit
+void coordinatorDtor(coordinator_t * coord);
+
+/// @brief worker process main loop: renders tiles for the coordinator at host:port until it disconnects
+int runWorker(const char * host, const uint16_t port);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef FRAME_ALLOC_INCLUDED
+#define FRAME_ALLOC_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+
+// every frame buffer is aligned to the cache line (enough for aligned and streaming ymm stores)
+const size_t FRAME_ALIGNMENT = 64;
+
+// buffers not less than this size are mmap'ed and advised to be backed by huge pages
+const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+// maximum number of buffers (both used and free) kept by the arena
+const size_t FRAME_ARENA_SIZE = 64;
+
+// transparent huge pages are used for big buffers, uncomment to use explicit (preallocated) ones
+// #define EXPLICIT_HUGE_PAGES
+
+// maximum number of NUMA nodes looked up in sysfs when cpus for pinned threads are ordered
+const int MAX_NUMA_NODES = 64;
+
+/// @brief allocates aligned zeroed buffer of at least size bytes, reusing free arena buffers if possible;
+///        new buffer is first touched by touch_parts threads: part i is bytes [size * i / touch_parts, size * (i + 1) / touch_parts)
+///        with bounds rounded to huge pages, it is the band of rows of worker i of calcMandelbrotMultiThread,
+///        so if thread pinning is on the pages of the band are placed on the NUMA node of the cpu which renders it;
+///        free buffer with placed pages is reused only for the same size and touch_parts, and it is cleared by the same threads
+void * frameAlloc(const size_t size, const size_t touch_parts);
+
+/// @brief returns buffer to the arena (it is not freed and can be reused by next frameAlloc)
+void frameFree(void * buffer);
+
+/// @brief frees every buffer of the arena which is not used now
+void frameArenaRelease();
+
+/// @brief turns binding of worker threads to cpus on or off (off by default, so that threads of a program
+///        using the library are not moved); it is called before any rendering starts
+void setThreadPinning(const bool is_on);
+
+/// @brief if pinning is on, binds calling thread to the cpu of worker thread_index: cpus are taken from
+///        the affinity mask of the process grouped by NUMA nodes, so workers of all multithreaded functions
+///        with the same index run on the same cpu; returns false if the thread is not bound
+bool bindThreadToCpu(const size_t thread_index);
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef ITER_FILE_INCLUDED
+#define ITER_FILE_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "mandelbrot.h"
+
+const uint32_t ITER_FILE_MAGIC   = 0x5449444D;     // "MDIT"
+const uint32_t ITER_FILE_VERSION = 1;
+
+// frame is stored in square tiles of this size, every tile can be decoded separately
+const uint32_t ITER_TILE_SIZE = 64;
+
+// files with bigger tiles are taken for damaged ones (a tile is decoded into a buffer of tile_size^2 numbers)
+const uint32_t MAX_ITER_TILE_SIZE = 1024;
+
+// file layout: header, encoded tiles (row by row of tiles), zero padding up to alignment of iter_tile_entry_t, index of tiles;
+// in every row of a tile values are replaced by zigzag coded differences with the left pixel
+// (first pixel - with the one above it), row is stored as one byte of bit width and differences packed in it
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+
+    float center_x;
+    float center_y;
+    float scale;
+    uint32_t iter_num;
+
+    uint32_t width;
+    uint32_t height;
+    uint32_t tile_size;
+    uint32_t tiles_x;
+    uint32_t tiles_y;
+    uint32_t reserved;
+
+    uint64_t index_offset;      // tiles_x * tiles_y of iter_tile_entry_t
+} iter_file_header_t;
+
+typedef struct {
+    uint64_t offset;
+    uint64_t size;
+} iter_tile_entry_t;
+
+typedef struct iter_writer iter_writer_t;
+
+typedef struct iter_file iter_file_t;
+
+/// @brief creates file for iteration data of frame with view and size of md (md->num_pixels are not used)
+iter_writer_t * iterWriterCtor(const char * file_name, const mandelbrot_context_t * md);
+
+/// @brief appends next rows_num rows of the frame (rows can be added by bands of any size, so huge frames are not kept in memory)
+bool iterWriterAddRows(iter_writer_t * writer, const uint32_t * nums, const uint32_t rows_num);
+
+/// @brief writes the index and closes the file, returns false if anything was not written
+bool iterWriterDtor(iter_writer_t * writer);
+
+/// @brief saves md->num_pixels with view of md
+bool saveIterFile(const char * file_name, const mandelbrot_context_t * md);
+
+/// @brief maps the file into memory and checks its header and index
+iter_file_t * iterFileOpen(const char * file_name);
+
+const iter_file_header_t * iterFileHeader(const iter_file_t * file);
+
+/// @brief decodes region of the frame into nums (with row length width), only tiles which intersect the region are read;
+///        returns false if the region is out of the frame or a tile is damaged
+bool iterFileDecode(const iter_file_t * file, uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                    uint32_t * nums, const size_t threads_num);
+
+void iterFileClose(iter_file_t * file);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef ITER_PROBE_INCLUDED
+#define ITER_PROBE_INCLUDED
+
+#include "mandelbrot.h"
+
+// probe is rendered in resolution (sc_width / PROBE_DIVIDER) x (sc_height / PROBE_DIVIDER)
+const uint32_t PROBE_DIVIDER = 8;
+
+// limit is raised if more than this share of probe pixels escapes only beyond it
+const double PROBE_RAISE_SHARE = 2e-3;
+
+// limit is halved if not more than this share of probe pixels escapes in its upper half
+const double PROBE_LOWER_SHARE = 5e-4;
+
+const uint32_t PROBE_MIN_ITER_NUM = 64;
+const uint32_t PROBE_MAX_ITER_NUM = 1 << 16;
+
+typedef struct {
+    uint32_t iter_num;
+
+    size_t probe_pixels;
+    size_t probe_calcs;     // number of probe pixels calculations (pixels are recalculated for every tried limit,
+                            // the ones inside main cardioid and period-2 bulb are not calculated)
+    double time;            // in ms
+} iter_probe_result_t;
+
+/// @brief chooses iteration limit for the current view by low resolution probe render:
+///        limit is doubled while meaningful share of probe pixels escapes only beyond it
+///        and halved while (almost) none of them escapes in the upper half of it
+iter_probe_result_t probeIterNum(const mandelbrot_context_t * md);
+
+#endif
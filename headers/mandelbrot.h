@@ -2,6 +2,7 @@
 #define MANDELBROT_INCLUDED
 
 #include <stdint.h>
+#include <stddef.h>
 
 /* DEFAULT VALUES */
 const float    DEFAULT_PLOT_WIDTH = 2.0;
@@ -9,23 +10,51 @@ const float    DEFAULT_CENTER_X   = -0.5;
 const float    DEFAULT_CENTER_Y   = 0.0;
 const uint32_t DEFAULT_ITER_NUM = 256;
 
+// number of workers in multithreaded rendering (frame buffers are first touched by the same number of threads)
+const size_t DEFAULT_THREADS_NUM = 8;
+
 // #define BURNING_SHIP
 
 #define GCC_OPT_PACK_SIZE 32
 
 
+// SIMD kernels use AVX2 (or SSE without AVX_ON) on x86 and portable GCC vector extensions
+// on other targets (see headers/simd.h)
 #define AVX_ON
 
+// uncomment to use portable vector extensions on any target
+// #define SIMD_GENERIC
+
+// frames are written by non-temporal stores (they are not read by the cpu right after rendering)
+// #define STREAM_STORES
+
 // number of intrinsic commands in one pack for better conveyorization
 #define INTRIN_PACK_SIZE 3
 
 const size_t COLOR_TABLE_LEN = 1024;
 
+// kernels calculate whole packs, so the last pack of the frame may be stored beyond its end
+const size_t FRAME_PADDING_PIXELS = 64;
+
+// pixels closer to the set than this distance (in pixel widths) are drawn as the set boundary
+const float DIST_BOUNDARY_PIXELS = 1.f;
+
+// distance kernel stops iterating a pixel when |dp_n| times pixel width exceeds this value: images of the pixel
+// neighborhood are much wider than the escape radius, so the pixel is closer than a pixel width to the set
+// (its escape number is not calculated, such pixels are filled as the boundary)
+const float DIST_DERIVATIVE_BAILOUT = 1e2f;
+
+// pixels further than this distance (in pixel widths) are not darkened by distance shading
+const float DIST_SHADE_PIXELS = 8.f;
+
 typedef struct {
     uint32_t * num_pixels;
     uint32_t * color_pixels;
     uint32_t * color_table;
 
+    // exterior distance estimation in pixel widths (0 for points of the set)
+    float    * dist_pixels;
+
     float scale;
     float center_x;
     float center_y;
@@ -41,9 +70,51 @@ mandelbrot_context_t mandelbrotCtor(const uint32_t width, const uint32_t height)
 /// @brief mandelbrot_context_t destructor
 void mandelbrotDtor(mandelbrot_context_t * md);
 
+/// @brief changes screen size keeping the view, frame buffers are reused through the frame arena
+void mandelbrotResize(mandelbrot_context_t * md, const uint32_t width, const uint32_t height);
+
+/// @brief name of the vector backend the SIMD kernels are compiled for
+const char * simdBackendName();
+
+/// @brief fills context.color_table (COLOR_TABLE_LEN colors)
+void calculateColorTable(const mandelbrot_context_t * md);
+
 /// @brief fills context.color_pixels with color codes
 void numsToColor(const mandelbrot_context_t * md);
 
+/// @brief fills context.color_pixels with color codes shaded by distance estimation (context.dist_pixels)
+void distToColor(const mandelbrot_context_t * md);
+
+/// @brief chooses iteration limit for the current view by distance estimation (context.dist_pixels),
+///        raises it if there are non escaped pixels further than DIST_BOUNDARY_PIXELS from the set
+///        or if resolved pixels escape near the limit (the latest 0.01% of them are not taken into account)
+uint32_t estimateIterNumByDistance(const mandelbrot_context_t * md);
+
+/// @brief color code of the pixel with escape number num (points of the set are black)
+inline uint32_t numToColorCode(const uint32_t * color_table, const uint32_t num, const uint32_t iter_num)
+{
+    return (num == iter_num) ? 0 : color_table[num % COLOR_TABLE_LEN];
+}
+
+/// @brief checks if point is inside the main cardioid or the period-2 bulb, such points never escape
+///        (always false for Burning Ship)
+inline bool isInMainBulbs(const float x, const float y)
+{
+  #ifdef BURNING_SHIP
+    (void)x;
+    (void)y;
+    return false;
+  #else
+    float y2 = y * y;
+
+    float q = (x - 0.25f) * (x - 0.25f) + y2;
+    if (q * (q + (x - 0.25f)) <= 0.25f * y2)
+        return true;
+
+    return (x + 1) * (x + 1) + y2 <= 1.f / 16;
+  #endif
+}
+
 
 /*************** CALCULATING MANDELBROT SET FUNCTIONS ************** */
 
@@ -53,16 +124,48 @@ void calcMandelbrot(mandelbrot_context_t * md);
 /// @brief intrinsics and better conveyorization
 void calcMandelbrotConveyor(mandelbrot_context_t * md);
 
-/// @brief bad realisation of multithreading
+/// @brief calcMandelbrotConveyor of rows [row_begin, row_end) only, rows are exactly the same as in the whole frame
+///        and nothing is written out of them, so different rows can be calculated by different threads
+void calcMandelbrotConveyorRows(const mandelbrot_context_t * md, const uint32_t row_begin, const uint32_t row_end);
+
+/// @brief calcMandelbrotConveyorRows which stores rows [row_begin, row_end) into tile_pixels instead of context.num_pixels
+void calcMandelbrotConveyorTile(const mandelbrot_context_t * md, const uint32_t row_begin, const uint32_t row_end, uint32_t * tile_pixels);
+
+/// @brief calcMandelbrotConveyorRows in threads_num threads, every thread gets its own band of rows
 void calcMandelbrotMultiThread(mandelbrot_context_t * md, size_t threads_num);
 
+/// @brief intrinsics with derivative tracking, fills context.dist_pixels with distance estimation;
+///        pixels closer than a pixel width to the set are stopped early (see DIST_DERIVATIVE_BAILOUT) and get zero distance
+void calcMandelbrotDistance(mandelbrot_context_t * md);
+
+/// @brief calcMandelbrotDistance of rows [row_begin, row_end) only (nothing is written out of them)
+void calcMandelbrotDistanceRows(const mandelbrot_context_t * md, const uint32_t row_begin, const uint32_t row_end);
+
+/// @brief calcMandelbrotDistance divided between threads the same way as calcMandelbrotMultiThread
+void calcMandelbrotDistanceMultiThread(mandelbrot_context_t * md, size_t threads_num);
+
 /// @brief divided into small loops for compiler avtovectorization
 void calcMandelbrotGCCoptimized(mandelbrot_context_t * md);
 
 /// @brief basic version without any optimizations
 void calcMandelbrotNoOptimization(mandelbrot_context_t * md);
 
+/// @brief intrinsics over arbitrary points (x0_arr[i], y0_arr[i]), escape numbers are stored into nums
+void calcMandelbrotPoints(const float * x0_arr, const float * y0_arr, uint32_t * nums, const size_t points_num, const uint32_t iter_num);
+
 /******************************************************************* */
 
+// kernels of the generic backend which are built in addition to the native ones (see Makefile),
+// they are only benchmarked against them
+namespace simd_generic {
+    const char * simdBackendName();
+
+    void calcMandelbrotConveyor(mandelbrot_context_t * md);
+
+    void calcMandelbrotMultiThread(mandelbrot_context_t * md, size_t threads_num);
+
+    void calcMandelbrotDistance(mandelbrot_context_t * md);
+}
+
 
 #endif
@@ -0,0 +1,98 @@
+#ifndef MANDELBROT_ENGINE_INCLUDED
+#define MANDELBROT_ENGINE_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "mandelbrot.h"
+
+// frame is divided into tiles of this number of rows, tiles are the units of work for the engine workers
+const uint32_t ENGINE_TILE_ROWS = 8;
+
+const size_t ENGINE_MAX_THREADS = 32;
+
+/// @brief what to render: immutable description of the view, it is copied into every job
+typedef struct {
+    float center_x;
+    float center_y;
+    float scale;            // plot units in one pixel
+    uint32_t iter_num;
+} mandelbrot_view_t;
+
+/// @brief where to render: output buffers of the frame, one target must not be used by two jobs at the same time
+typedef struct {
+    uint32_t * num_pixels;
+    uint32_t * color_pixels;
+
+    uint32_t width;
+    uint32_t height;
+
+    size_t capacity;        // in pixels, buffers are not reallocated while the frame fits
+
+    size_t workers_num;     // buffers are divided into this number of bands, pages of band i are placed for worker i
+} render_target_t;
+
+typedef enum {
+    RENDER_IN_PROGRESS = 0,
+    RENDER_DONE,
+    RENDER_CANCELLED
+} render_status_t;
+
+typedef struct render_engine render_engine_t;
+typedef struct render_job    render_job_t;
+
+/// @brief view of the whole set for the screen of this width
+mandelbrot_view_t defaultView(const uint32_t width);
+
+/// @brief render_target_t constructor (buffers are taken from the frame arena); workers_num is the pool size of the engine
+///        which renders into the target: every worker first renders tiles of its own band, so the pages of the band are
+///        placed on the NUMA node of the worker (1 - pages are not placed)
+render_target_t renderTargetCtor(const uint32_t width, const uint32_t height, const size_t workers_num);
+
+/// @brief changes frame size, buffers are reallocated only if the new frame does not fit in them
+void renderTargetResize(render_target_t * target, const uint32_t width, const uint32_t height);
+
+/// @brief render_target_t destructor
+void renderTargetDtor(render_target_t * target);
+
+/// @brief creates engine with pool of threads_num workers shared by all jobs
+render_engine_t * renderEngineCtor(const size_t threads_num);
+
+/// @brief cancels all jobs, waits for their running tiles and stops workers; jobs which are not released are freed,
+///        their pointers must not be used anymore (no thread may wait for them at the same time)
+void renderEngineDtor(render_engine_t * engine);
+
+/// @brief only first threads_num workers of the pool take tiles (1 <= threads_num <= pool size), others sleep;
+///        running jobs are continued by the active workers
+void renderSetActiveThreads(render_engine_t * engine, size_t threads_num);
+
+/// @brief number of workers which take tiles
+size_t renderActiveThreads(render_engine_t * engine);
+
+/// @brief starts rendering of view into target, can be called from any thread;
+///        num_pixels are calculated and colored into color_pixels (if it is not NULL) tile by tile
+render_job_t * renderSubmit(render_engine_t * engine, const mandelbrot_view_t * view, render_target_t * target);
+
+/// @brief asks workers to stop the job: tiles which are not started are skipped, the job is finished as soon as running ones are
+void renderCancel(render_job_t * job);
+
+/// @brief status of the job without waiting
+render_status_t renderStatus(render_job_t * job);
+
+/// @brief number of tiles (of ENGINE_TILE_ROWS rows) in the frame of the job
+uint32_t renderTilesNum(const render_job_t * job);
+
+/// @brief marks finished tiles of the job in tiles_done (renderTilesNum elements) and returns their number,
+///        pixels of marked tiles are ready and are not changed by the job anymore
+uint32_t renderDoneTiles(render_job_t * job, bool * tiles_done);
+
+/// @brief waits until the job is done or cancelled
+render_status_t renderWait(render_job_t * job);
+
+/// @brief waits for the job and frees it
+render_status_t renderRelease(render_job_t * job);
+
+/// @brief renderSubmit + renderRelease
+render_status_t renderView(render_engine_t * engine, const mandelbrot_view_t * view, render_target_t * target);
+
+#endif
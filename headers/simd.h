@@ -0,0 +1,191 @@
+#ifndef SIMD_INCLUDED
+#define SIMD_INCLUDED
+
+// thin vector layer of the SIMD kernels: mXXX (floats) and mXXXi (int32) packs with mm_* operations,
+// every backend gives the same operations, so kernels are written once;
+// mm_any_ps is nonzero if sign bit of any lane is set (lanes of comparison results are all ones or zeros)
+
+#include <stdint.h>
+#include <string.h>
+
+#include "mandelbrot.h"
+
+#if defined(SIMD_GENERIC)
+    #define SIMD_BACKEND_GENERIC
+#elif defined(__x86_64__) || defined(__i386__)
+    #ifdef AVX_ON
+        #define SIMD_BACKEND_AVX
+    #else
+        #define SIMD_BACKEND_SSE
+    #endif
+#else
+    // on ARM the generic backend is lowered to NEON by the compiler
+    #define SIMD_BACKEND_GENERIC
+#endif
+
+#if defined(SIMD_BACKEND_AVX)
+    #include <immintrin.h>
+
+    #define SIMD_BACKEND_NAME "AVX2"
+
+    typedef __m256 mXXX;
+    typedef __m256i mXXXi;
+
+    // size of ymm register in bytes
+    #define PACK_SIZE 32
+    #define NUMS_IN_PACK (PACK_SIZE / sizeof(float))
+
+    // x coordinates of the pack points relative to the first one (reversed for easy storing in the memory)
+    #define mm_delta_ps(dx)     _mm256_set_ps((dx)*7, (dx)*6, (dx)*5, (dx)*4, (dx)*3, (dx)*2, (dx), 0)
+
+    #define mm_set1_ps          _mm256_set1_ps
+    #define mm_loadu_ps         _mm256_loadu_ps
+
+    #define mm_castsiXXX_ps     _mm256_castsi256_ps
+    #define mm_castps_siXXX     _mm256_castps_si256
+
+    #define mm_add_ps           _mm256_add_ps
+    #define mm_mul_ps           _mm256_mul_ps
+    #define mm_sub_ps           _mm256_sub_ps
+    #define mm_and_ps           _mm256_and_ps
+    #define mm_blendv_ps        _mm256_blendv_ps
+
+    #define mm_cmple_ps(a, b)   _mm256_cmp_ps((a), (b), _CMP_LE_OS)
+
+    #define mm_any_ps           _mm256_movemask_ps
+
+    #define mm_set1_epi32       _mm256_set1_epi32
+    #define mm_add_epi32        _mm256_add_epi32
+    #define mm_storeu_siXXX     _mm256_storeu_si256
+    #define mm_store_siXXX      _mm256_store_si256
+    #define mm_stream_siXXX     _mm256_stream_si256
+    #define mm_storeu_ps        _mm256_storeu_ps
+    #define mm_and_siXXX        _mm256_and_si256
+
+    #define mm_sfence           _mm_sfence
+
+#elif defined(SIMD_BACKEND_SSE)
+    #include <immintrin.h>
+
+    #define SIMD_BACKEND_NAME "SSE"
+
+    typedef __m128  mXXX;
+    typedef __m128i mXXXi;
+
+    // size of xmm register in bytes
+    #define PACK_SIZE 16
+    #define NUMS_IN_PACK (PACK_SIZE / sizeof(float))
+
+    #define mm_delta_ps(dx)     _mm_set_ps((dx)*3, (dx)*2, (dx), 0)
+
+    #define mm_set1_ps          _mm_set1_ps
+    #define mm_loadu_ps         _mm_loadu_ps
+
+    #define mm_castsiXXX_ps     _mm_castsi128_ps
+    #define mm_castps_siXXX     _mm_castps_si128
+
+    #define mm_add_ps           _mm_add_ps
+    #define mm_mul_ps           _mm_mul_ps
+    #define mm_sub_ps           _mm_sub_ps
+    #define mm_and_ps           _mm_and_ps
+    #define mm_blendv_ps        _mm_blendv_ps
+
+    #define mm_cmple_ps         _mm_cmple_ps
+    #define mm_any_ps           _mm_movemask_ps
+
+    #define mm_set1_epi32       _mm_set1_epi32
+    #define mm_add_epi32        _mm_add_epi32
+    #define mm_storeu_siXXX     _mm_storeu_si128
+    #define mm_store_siXXX      _mm_store_si128
+    #define mm_stream_siXXX     _mm_stream_si128
+    #define mm_storeu_ps        _mm_storeu_ps
+    #define mm_and_siXXX        _mm_and_si128
+
+    #define mm_sfence           _mm_sfence
+
+#else
+    // GCC vector extensions, compiler lowers them to the vector instructions of the target (or to scalar code)
+    #define SIMD_BACKEND_NAME "GENERIC"
+
+    // packs wider than vector registers of the target are passed through the memory
+    #ifdef __AVX__
+        #define PACK_SIZE 32
+    #else
+        #define PACK_SIZE 16
+    #endif
+    #define NUMS_IN_PACK (PACK_SIZE / sizeof(float))
+
+    typedef float   mXXX  __attribute__((vector_size(PACK_SIZE)));
+    typedef int32_t mXXXi __attribute__((vector_size(PACK_SIZE)));
+
+    static inline mXXX mm_delta_ps(const float dx)
+    {
+        mXXX delta = {};
+
+        for (size_t lane_index = 0; lane_index < NUMS_IN_PACK; lane_index++)
+            delta[lane_index] = lane_index * dx;
+
+        return delta;
+    }
+
+    static inline mXXX mm_set1_ps(const float a)
+    {
+        return (mXXX){} + a;
+    }
+
+    static inline mXXX mm_loadu_ps(const float * addr)
+    {
+        mXXX a;
+        memcpy(&a, addr, sizeof(a));
+        return a;
+    }
+
+    #define mm_castsiXXX_ps(a)  ((mXXX) (a))
+    #define mm_castps_siXXX(a)  ((mXXXi)(a))
+
+    #define mm_add_ps(a, b)     ((a) + (b))
+    #define mm_mul_ps(a, b)     ((a) * (b))
+    #define mm_sub_ps(a, b)     ((a) - (b))
+    #define mm_and_ps(a, b)     ((mXXX)((mXXXi)(a) & (mXXXi)(b)))
+
+    static inline mXXX mm_blendv_ps(const mXXX a, const mXXX b, const mXXX mask)
+    {
+        const mXXXi b_lanes = (mXXXi)mask >> 31;
+        return (mXXX)(((mXXXi)a & ~b_lanes) | ((mXXXi)b & b_lanes));
+    }
+
+    #define mm_cmple_ps(a, b)   ((mXXX)((a) <= (b)))
+
+    // pairs of lanes are ored together, compiler keeps them in vector registers
+    static inline int mm_any_ps(const mXXX a)
+    {
+        typedef int32_t pair_t __attribute__((vector_size(2 * sizeof(int32_t))));
+
+        pair_t lanes_or = {};
+
+        for (size_t offset = 0; offset < PACK_SIZE; offset += sizeof(pair_t)){
+            pair_t pair = {};
+            memcpy(&pair, (const char *)&a + offset, sizeof(pair));
+            lanes_or |= pair;
+        }
+
+        return (int)((uint32_t)(lanes_or[0] | lanes_or[1]) >> 31);
+    }
+
+    static inline mXXXi mm_set1_epi32(const int32_t a)
+    {
+        return (mXXXi){} + a;
+    }
+
+    #define mm_add_epi32(a, b)  ((a) + (b))
+    #define mm_and_siXXX(a, b)  ((a) & (b))
+
+    #define mm_storeu_siXXX(addr, a)    do { mXXXi stored_ = (a); memcpy((addr), &stored_, sizeof(stored_)); } while(0)
+    #define mm_store_siXXX(addr, a)     (*(mXXXi *)(addr) = (a))
+    #define mm_stream_siXXX(addr, a)    (*(mXXXi *)(addr) = (a))
+    #define mm_storeu_ps(addr, a)       do { mXXX  stored_ = (a); memcpy((addr), &stored_, sizeof(stored_)); } while(0)
+
+    #define mm_sfence()
+#endif
+
+#endif
@@ -2,6 +2,7 @@
 #define TEST_MANDELBROT_INCLUDED
 
 #include "mandelbrot.h"
+#include "distributed.h"
 
 typedef struct {
     double time;
@@ -17,6 +18,35 @@ void testMandelbrot(mandelbrot_context_t * md, const size_t measure_time);
 /// @brief shell for calcMandelbrotMultithread for prototype unification
 void calcMandelbrot8Threads(mandelbrot_context_t * md);
 
+/// @brief calcMandelbrot8Threads with coloring (base for antialiasing cost)
+void calcMandelbrot8ThreadsColored(mandelbrot_context_t * md);
+
+/// @brief calcMandelbrot8Threads with coloring and adaptive antialiasing
+void calcMandelbrot8ThreadsAntialiased(mandelbrot_context_t * md);
+
+/// @brief rendering by the engine with pool of 8 workers (pool is created by the first call and shared by all calls of the test)
+void renderEngine8Workers(mandelbrot_context_t * md);
+
+/// @brief shell for probeIterNum for prototype unification (context is not changed)
+void probeIterNumOnly(mandelbrot_context_t * md);
+
+/// @brief renders Buddhabrot and Nebulabrot with uniform and Metropolis sampling, prints throughput into stdout
+void testBuddhabrot(mandelbrot_context_t * md, const size_t samples_num);
+
+/// @brief renders frames_num frames by coordinator with params, prints per worker throughput and compares frames with local render
+void testDistributed(mandelbrot_context_t * md, const coordinator_params_t * params, const size_t frames_num);
+
+/// @brief renders default view in width x height by bands into iteration file, prints times and compression ratio
+void testIterFileSave(const char * file_name, const uint32_t width, const uint32_t height);
+
+/// @brief decodes region of iteration file (zero size - the whole frame) and colors it by bands of tile rows, prints times
+void testIterFileRecolor(const char * file_name, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+/// @brief renders catalogue of views by every kernel and thread number, prints per kernel mismatches and max iteration
+///        deviation from golden frames of golden_dir (is_update - golden frames are rendered by the reference kernel instead);
+///        returns false if any kernel is out of tolerance or its threaded version differs from the single threaded one
+bool testGolden(const char * golden_dir, const bool is_update);
+
 /// @brief prints main information about this session
 void printOptionsInfo(mandelbrot_context_t * md);
 
@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "antialiasing.h"
+#include "mandelbrot.h"
+
+const size_t AA_SAMPLES_NUM = AA_GRID_SIZE * AA_GRID_SIZE;
+
+typedef struct {
+    const mandelbrot_context_t * md;
+
+    // rows thread_index, thread_index + threads_num, ... are antialiased by this thread
+    uint32_t first_row;
+    uint32_t row_step;
+
+    size_t edge_num;
+} aa_thread_task_t;
+
+static void * threadAntialias(void * task_ptr);
+
+static void antialiasPixels(const mandelbrot_context_t * md, const size_t * edge_pixels, const size_t edge_num);
+
+static uint32_t averageColors(const uint32_t * colors, const size_t colors_num);
+
+static float jitter(const uint32_t pixel_index, const uint32_t sample_index);
+
+
+size_t antialiasMandelbrot(mandelbrot_context_t * md, const size_t threads_num)
+{
+    assert(md);
+    assert(threads_num > 0);
+
+    const size_t MAX_THREAD_NUM = 32;
+    assert(threads_num <= MAX_THREAD_NUM);
+
+    aa_thread_task_t tasks[MAX_THREAD_NUM] = {};
+    pthread_t threads[MAX_THREAD_NUM] = {};
+
+    // edges are denser in some parts of the frame, so rows are interleaved between threads
+    for (size_t thread_index = 0; thread_index < threads_num; thread_index++){
+        tasks[thread_index].md        = md;
+        tasks[thread_index].first_row = (uint32_t)thread_index;
+        tasks[thread_index].row_step  = (uint32_t)threads_num;
+
+        pthread_create(threads + thread_index, NULL, threadAntialias, tasks + thread_index);
+    }
+
+    size_t edge_num = 0;
+
+    for (size_t thread_index = 0; thread_index < threads_num; thread_index++){
+        pthread_join(threads[thread_index], NULL);
+
+        edge_num += tasks[thread_index].edge_num;
+    }
+
+    return edge_num;
+}
+
+static inline bool isFarNum(const uint32_t num, const uint32_t neighbor)
+{
+    return (neighbor > num ? neighbor - num : num - neighbor) > AA_NUM_THRESHOLD;
+}
+
+/// @brief edge pixels (which differ from one of their 4 neighbors more than AA_NUM_THRESHOLD) are found row by row
+///        and antialiased by batches as soon as a batch is full, so no list of edges of the whole frame is kept
+static void * threadAntialias(void * task_ptr)
+{
+    assert(task_ptr);
+
+    aa_thread_task_t * task = (aa_thread_task_t *)task_ptr;
+    const mandelbrot_context_t * md = task->md;
+
+    const uint32_t sc_width  = md->sc_width;
+    const uint32_t sc_height = md->sc_height;
+
+    size_t batch[AA_BATCH_PIXELS] = {};
+    size_t batch_size = 0;
+
+    for (uint32_t iy = task->first_row; iy < sc_height; iy += task->row_step){
+        // pixels out of the frame are taken equal to the border ones
+        const uint32_t * row   = md->num_pixels + (size_t)iy * sc_width;
+        const uint32_t * upper = (iy > 0)             ? row - sc_width : row;
+        const uint32_t * lower = (iy + 1 < sc_height) ? row + sc_width : row;
+
+        for (uint32_t ix = 0; ix < sc_width; ix++){
+            const uint32_t num   = row[ix];
+            const uint32_t left  = (ix > 0)            ? row[ix - 1] : num;
+            const uint32_t right = (ix + 1 < sc_width) ? row[ix + 1] : num;
+
+            if (! isFarNum(num, left) && ! isFarNum(num, right) && ! isFarNum(num, upper[ix]) && ! isFarNum(num, lower[ix]))
+                continue;
+
+            batch[batch_size++] = (size_t)iy * sc_width + ix;
+            task->edge_num++;
+
+            if (batch_size == AA_BATCH_PIXELS){
+                antialiasPixels(md, batch, batch_size);
+                batch_size = 0;
+            }
+        }
+    }
+
+    if (batch_size > 0)
+        antialiasPixels(md, batch, batch_size);
+
+    return NULL;
+}
+
+/// @brief replaces colors of edge_num edge pixels with average color of their jittered subsamples
+static void antialiasPixels(const mandelbrot_context_t * md, const size_t * edge_pixels, const size_t edge_num)
+{
+    assert(md);
+    assert(edge_pixels);
+    assert(edge_num <= AA_BATCH_PIXELS);
+
+    const float left_x   = md->center_x - md->sc_width  * md->scale / 2;
+    const float bottom_y = md->center_y - md->sc_height * md->scale / 2;
+
+    const float dx = md->scale;
+    const float dy = dx;
+
+    float    x0[AA_BATCH_PIXELS * AA_SAMPLES_NUM] = {};
+    float    y0[AA_BATCH_PIXELS * AA_SAMPLES_NUM] = {};
+    uint32_t nums[AA_BATCH_PIXELS * AA_SAMPLES_NUM] = {};
+
+    // stratified jittered grid inside every pixel
+    for (size_t edge_index = 0; edge_index < edge_num; edge_index++){
+        const size_t pixel_index = edge_pixels[edge_index];
+
+        const uint32_t ix = pixel_index % md->sc_width;
+        const uint32_t iy = pixel_index / md->sc_width;
+
+        for (uint32_t sample_index = 0; sample_index < AA_SAMPLES_NUM; sample_index++){
+            const uint32_t sub_x = sample_index % AA_GRID_SIZE;
+            const uint32_t sub_y = sample_index / AA_GRID_SIZE;
+
+            float shift_x = (sub_x + jitter((uint32_t)pixel_index, 2 * sample_index    )) / AA_GRID_SIZE - 0.5f;
+            float shift_y = (sub_y + jitter((uint32_t)pixel_index, 2 * sample_index + 1)) / AA_GRID_SIZE - 0.5f;
+
+            x0[edge_index * AA_SAMPLES_NUM + sample_index] = left_x   + (ix + shift_x) * dx;
+            y0[edge_index * AA_SAMPLES_NUM + sample_index] = bottom_y + (iy + shift_y) * dy;
+        }
+    }
+
+    calcMandelbrotPoints(x0, y0, nums, edge_num * AA_SAMPLES_NUM, md->iter_num);
+
+    for (size_t edge_index = 0; edge_index < edge_num; edge_index++){
+        uint32_t colors[AA_SAMPLES_NUM] = {};
+
+        for (size_t sample_index = 0; sample_index < AA_SAMPLES_NUM; sample_index++){
+            colors[sample_index] = numToColorCode(md->color_table, nums[edge_index * AA_SAMPLES_NUM + sample_index], md->iter_num);
+        }
+
+        md->color_pixels[edge_pixels[edge_index]] = averageColors(colors, AA_SAMPLES_NUM);
+    }
+}
+
+static uint32_t averageColors(const uint32_t * colors, const size_t colors_num)
+{
+    assert(colors);
+
+    uint32_t channel_sum[4] = {};
+
+    for (size_t color_index = 0; color_index < colors_num; color_index++){
+        for (size_t channel = 0; channel < 4; channel++){
+            channel_sum[channel] += (colors[color_index] >> (8 * channel)) & 0xFF;
+        }
+    }
+
+    uint32_t color = 0;
+    for (size_t channel = 0; channel < 4; channel++){
+        color |= ((channel_sum[channel] + colors_num / 2) / colors_num) << (8 * channel);
+    }
+
+    // points of the set are black with zero alpha, edge pixel should stay opaque
+    return color | (0xFFu << 24);
+}
+
+/// @brief deterministic pseudo random number in [0, 1), so the same frame is always antialiased the same way
+static float jitter(const uint32_t pixel_index, const uint32_t sample_index)
+{
+    uint32_t hash = pixel_index * 0x9E3779B1u + sample_index * 0x85EBCA77u;
+
+    hash ^= hash >> 16;
+    hash *= 0x7FEB352Du;
+    hash ^= hash >> 15;
+    hash *= 0x846CA68Bu;
+    hash ^= hash >> 16;
+
+    return (hash >> 8) * (1.f / (1 << 24));
+}
@@ -0,0 +1,461 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "buddhabrot.h"
+#include "mandelbrot.h"
+#include "frame_alloc.h"
+
+const size_t MAX_CHANNELS_NUM = 3;
+
+// c are sampled in this square, orbits of all other points escape at once
+const float SAMPLE_MIN = -2.f;
+const float SAMPLE_MAX =  2.f;
+
+typedef struct {
+    const mandelbrot_context_t * md;
+    const buddhabrot_params_t  * params;
+
+    size_t thread_index;
+    size_t samples_num;     // to sample
+
+    // channels_num histograms of sc_width * sc_height, owned by this thread only
+    // (weighted by Metropolis sampling, so they are not integer)
+    float * histogram;
+
+    // pixel indices of the orbit which is replayed now
+    size_t * orbit_pixels;
+
+    uint64_t rand_state;
+
+    size_t samples;         // sampled
+    size_t orbits;
+    size_t points;
+} buddha_thread_t;
+
+typedef struct {
+    float left_x;
+    float bottom_y;
+    float scale;
+
+    uint32_t sc_width;
+    uint32_t sc_height;
+} buddha_view_t;
+
+static void * threadBuddhabrot(void * thread_ptr);
+
+static void sampleUniform(buddha_thread_t * thread, const buddha_view_t * view);
+
+static void sampleMetropolis(buddha_thread_t * thread, const buddha_view_t * view);
+
+static size_t replayOrbit(const buddha_view_t * view, const float x0, const float y0, const uint32_t orbit_len, size_t * orbit_pixels);
+
+static void splatState(buddha_thread_t * thread, const buddha_view_t * view, const float x0, const float y0, const uint32_t num, const size_t steps_num);
+
+static void addOrbit(buddha_thread_t * thread, const uint32_t num, const size_t orbit_len, const float weight);
+
+static void toneMap(const mandelbrot_context_t * md, const float * histogram, const size_t channels_num);
+
+static uint32_t limitOfChannel(const buddhabrot_params_t * params, const mandelbrot_context_t * md, const size_t channel);
+
+static float randFloat(uint64_t * state);
+
+static float randGauss(uint64_t * state);
+
+
+buddhabrot_stats_t renderBuddhabrot(mandelbrot_context_t * md, const buddhabrot_params_t * params)
+{
+    assert(md);
+    assert(params);
+
+    const size_t MAX_THREAD_NUM = 32;
+    assert(params->threads_num > 0 && params->threads_num <= MAX_THREAD_NUM);
+
+    buddhabrot_stats_t stats = {};
+
+    struct timespec render_start = {};
+    struct timespec render_end   = {};
+    clock_gettime(CLOCK_MONOTONIC, &render_start);
+
+    const size_t channels_num = params->is_nebula ? MAX_CHANNELS_NUM : 1;
+    const size_t pixels_num   = (size_t)md->sc_width * md->sc_height;
+
+    uint32_t max_iter_num = 0;
+    for (size_t channel = 0; channel < channels_num; channel++){
+        if (limitOfChannel(params, md, channel) > max_iter_num)
+            max_iter_num = limitOfChannel(params, md, channel);
+    }
+
+    buddha_thread_t threads_data[MAX_THREAD_NUM] = {};
+    pthread_t threads[MAX_THREAD_NUM] = {};
+
+    for (size_t thread_index = 0; thread_index < params->threads_num; thread_index++){
+        buddha_thread_t * thread = threads_data + thread_index;
+
+        thread->md     = md;
+        thread->params = params;
+
+        thread->thread_index = thread_index;
+        thread->samples_num  = params->samples_num / params->threads_num + (thread_index < params->samples_num % params->threads_num);
+        thread->rand_state   = 0x9E3779B97F4A7C15ull * (thread_index + 1);
+
+        thread->histogram    = (float    *)frameAlloc(channels_num * pixels_num * sizeof(float), 1);
+        thread->orbit_pixels = (size_t   *)frameAlloc(max_iter_num * sizeof(size_t), 1);
+    }
+
+    for (size_t thread_index = 0; thread_index < params->threads_num; thread_index++){
+        if (! threads_data[thread_index].histogram || ! threads_data[thread_index].orbit_pixels){
+            fprintf(stderr, "ERROR: Could not allocate memory for Buddhabrot histograms\n");
+
+            for (size_t free_index = 0; free_index < params->threads_num; free_index++){
+                frameFree(threads_data[free_index].histogram);
+                frameFree(threads_data[free_index].orbit_pixels);
+            }
+            return stats;
+        }
+    }
+
+    for (size_t thread_index = 0; thread_index < params->threads_num; thread_index++){
+        pthread_create(threads + thread_index, NULL, threadBuddhabrot, threads_data + thread_index);
+    }
+
+    for (size_t thread_index = 0; thread_index < params->threads_num; thread_index++){
+        pthread_join(threads[thread_index], NULL);
+    }
+
+    // histograms are merged into the first one
+    float * histogram = threads_data[0].histogram;
+
+    for (size_t thread_index = 0; thread_index < params->threads_num; thread_index++){
+        buddha_thread_t * thread = threads_data + thread_index;
+
+        if (thread_index > 0){
+            for (size_t index = 0; index < channels_num * pixels_num; index++){
+                histogram[index] += thread->histogram[index];
+            }
+        }
+
+        stats.samples += thread->samples;
+        stats.orbits  += thread->orbits;
+        stats.points  += thread->points;
+    }
+
+    toneMap(md, histogram, channels_num);
+
+    for (size_t thread_index = 0; thread_index < params->threads_num; thread_index++){
+        frameFree(threads_data[thread_index].histogram);
+        frameFree(threads_data[thread_index].orbit_pixels);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &render_end);
+
+    stats.time = 1000 * (render_end.tv_sec - render_start.tv_sec) + (render_end.tv_nsec - render_start.tv_nsec) / 1e6;
+    stats.orbits_per_sec = stats.orbits / (stats.time / 1000);
+
+    return stats;
+}
+
+static void * threadBuddhabrot(void * thread_ptr)
+{
+    assert(thread_ptr);
+
+    buddha_thread_t * thread = (buddha_thread_t *)thread_ptr;
+    const mandelbrot_context_t * md = thread->md;
+
+    bindThreadToCpu(thread->thread_index);
+
+    // histogram is cleared (first touched) by its owner
+    const size_t channels_num = thread->params->is_nebula ? MAX_CHANNELS_NUM : 1;
+    memset(thread->histogram, 0, channels_num * (size_t)md->sc_width * md->sc_height * sizeof(float));
+
+    buddha_view_t view = {
+        .left_x    = md->center_x - md->sc_width  * md->scale / 2,
+        .bottom_y  = md->center_y - md->sc_height * md->scale / 2,
+        .scale     = md->scale,
+        .sc_width  = md->sc_width,
+        .sc_height = md->sc_height
+    };
+
+    if (thread->params->is_metropolis)
+        sampleMetropolis(thread, &view);
+    else
+        sampleUniform(thread, &view);
+
+    return NULL;
+}
+
+/// @brief c are sampled uniformly in the sampling square (except main bulbs)
+static void sampleUniform(buddha_thread_t * thread, const buddha_view_t * view)
+{
+    assert(thread);
+    assert(view);
+
+    const uint32_t max_iter_num = thread->params->is_nebula ? NEBULA_ITER_NUMS[0] : thread->md->iter_num;
+
+    float    x0  [BUDDHA_BATCH_SIZE] = {};
+    float    y0  [BUDDHA_BATCH_SIZE] = {};
+    uint32_t nums[BUDDHA_BATCH_SIZE] = {};
+
+    for (size_t sample_index = 0; sample_index < thread->samples_num; sample_index += BUDDHA_BATCH_SIZE){
+        const size_t batch_len = (thread->samples_num - sample_index < BUDDHA_BATCH_SIZE) ? thread->samples_num - sample_index : BUDDHA_BATCH_SIZE;
+        size_t batch_size = 0;
+
+        while (batch_size < batch_len){
+            float x = SAMPLE_MIN + (SAMPLE_MAX - SAMPLE_MIN) * randFloat(&thread->rand_state);
+            float y = SAMPLE_MIN + (SAMPLE_MAX - SAMPLE_MIN) * randFloat(&thread->rand_state);
+
+            if (isInMainBulbs(x, y))
+                continue;
+
+            x0[batch_size] = x;
+            y0[batch_size] = y;
+            batch_size++;
+        }
+
+        // first pass: escape test of the whole batch
+        calcMandelbrotPoints(x0, y0, nums, batch_size, max_iter_num);
+        thread->samples += batch_size;
+
+        // second pass: replaying escaped orbits
+        for (size_t index = 0; index < batch_size; index++){
+            if (nums[index] < BUDDHA_MIN_ITER_NUM || nums[index] >= max_iter_num)
+                continue;
+
+            size_t orbit_len = replayOrbit(view, x0[index], y0[index], nums[index], thread->orbit_pixels);
+            addOrbit(thread, nums[index], orbit_len, 1);
+        }
+    }
+}
+
+/// @brief BUDDHA_BATCH_SIZE Metropolis chains sampling c with density proportional to the contribution
+///        (points of the orbit in the view): proposal is a new uniform sample or a small mutation of the current c,
+///        it is accepted with probability min(1, new contribution / current contribution); the current state
+///        is splatted on every step with weight 1 / contribution, so the histogram is the same as with uniform sampling
+static void sampleMetropolis(buddha_thread_t * thread, const buddha_view_t * view)
+{
+    assert(thread);
+    assert(view);
+
+    const uint32_t max_iter_num = thread->params->is_nebula ? NEBULA_ITER_NUMS[0] : thread->md->iter_num;
+    const float mutation_sigma = METROPOLIS_MUTATION_SIGMA * view->scale * view->sc_width;
+
+    // chain state, its contribution (0 until the chain has started) and number of steps it has been kept
+    float    chain_x  [BUDDHA_BATCH_SIZE] = {};
+    float    chain_y  [BUDDHA_BATCH_SIZE] = {};
+    uint32_t chain_num[BUDDHA_BATCH_SIZE] = {};
+    size_t   chain_contrib[BUDDHA_BATCH_SIZE] = {};
+    size_t   chain_steps  [BUDDHA_BATCH_SIZE] = {};
+
+    float    x0  [BUDDHA_BATCH_SIZE] = {};
+    float    y0  [BUDDHA_BATCH_SIZE] = {};
+    uint32_t nums[BUDDHA_BATCH_SIZE] = {};
+
+    for (size_t sample_index = 0; sample_index < thread->samples_num; sample_index += BUDDHA_BATCH_SIZE){
+        const size_t chains_num = (thread->samples_num - sample_index < BUDDHA_BATCH_SIZE) ? thread->samples_num - sample_index : BUDDHA_BATCH_SIZE;
+
+        // proposal density p / area + (1 - p) * gauss(c' - c) is symmetric, so it cancels in the Hastings ratio;
+        // chains which have not started yet take uniform samples until the first one with contribution
+        for (size_t chain = 0; chain < chains_num; chain++){
+            if (chain_contrib[chain] == 0 || randFloat(&thread->rand_state) < METROPOLIS_UNIFORM_PROB){
+                x0[chain] = SAMPLE_MIN + (SAMPLE_MAX - SAMPLE_MIN) * randFloat(&thread->rand_state);
+                y0[chain] = SAMPLE_MIN + (SAMPLE_MAX - SAMPLE_MIN) * randFloat(&thread->rand_state);
+            }
+            else {
+                x0[chain] = chain_x[chain] + mutation_sigma * randGauss(&thread->rand_state);
+                y0[chain] = chain_y[chain] + mutation_sigma * randGauss(&thread->rand_state);
+            }
+        }
+
+        // first pass: escape test of all proposals
+        calcMandelbrotPoints(x0, y0, nums, chains_num, max_iter_num);
+        thread->samples += chains_num;
+
+        // second pass: contributions of proposals (target density is zero outside of the sampling square)
+        for (size_t chain = 0; chain < chains_num; chain++){
+            size_t contrib = 0;
+
+            bool is_sampled = x0[chain] >= SAMPLE_MIN && x0[chain] < SAMPLE_MAX && y0[chain] >= SAMPLE_MIN && y0[chain] < SAMPLE_MAX;
+
+            if (is_sampled && nums[chain] >= BUDDHA_MIN_ITER_NUM && nums[chain] < max_iter_num && ! isInMainBulbs(x0[chain], y0[chain]))
+                contrib = replayOrbit(view, x0[chain], y0[chain], nums[chain], thread->orbit_pixels);
+
+            bool is_accepted = contrib > 0 &&
+                (chain_contrib[chain] == 0 || randFloat(&thread->rand_state) * chain_contrib[chain] < contrib);
+
+            if (is_accepted){
+                splatState(thread, view, chain_x[chain], chain_y[chain], chain_num[chain], chain_steps[chain]);
+
+                chain_x  [chain] = x0[chain];
+                chain_y  [chain] = y0[chain];
+                chain_num[chain] = nums[chain];
+                chain_contrib[chain] = contrib;
+                chain_steps  [chain] = 0;
+            }
+
+            // rejected proposal means one more step in the current state
+            if (chain_contrib[chain] > 0)
+                chain_steps[chain]++;
+        }
+    }
+
+    for (size_t chain = 0; chain < BUDDHA_BATCH_SIZE; chain++){
+        splatState(thread, view, chain_x[chain], chain_y[chain], chain_num[chain], chain_steps[chain]);
+    }
+}
+
+/// @brief adds the state kept by a chain for steps_num steps: every step adds its orbit with weight 1 / contribution
+///        (the orbit is replayed once for all of them)
+static void splatState(buddha_thread_t * thread, const buddha_view_t * view, const float x0, const float y0, const uint32_t num, const size_t steps_num)
+{
+    assert(thread);
+    assert(view);
+
+    if (steps_num == 0)
+        return;
+
+    size_t orbit_len = replayOrbit(view, x0, y0, num, thread->orbit_pixels);
+    assert(orbit_len > 0);
+
+    addOrbit(thread, num, orbit_len, (float)steps_num / orbit_len);
+}
+
+/// @brief writes pixel indices of first orbit_len points of the orbit of (x0, y0) which are in the view, returns their number
+static size_t replayOrbit(const buddha_view_t * view, const float x0, const float y0, const uint32_t orbit_len, size_t * orbit_pixels)
+{
+    assert(view);
+    assert(orbit_pixels);
+
+    const float inv_scale = 1 / view->scale;
+
+    float x = x0;
+    float y = y0;
+
+    size_t points_num = 0;
+
+    for (uint32_t iteration = 0; iteration < orbit_len; iteration++){
+        float pixel_x = (x - view->left_x)   * inv_scale;
+        float pixel_y = (y - view->bottom_y) * inv_scale;
+
+        if (pixel_x >= 0 && pixel_x < view->sc_width && pixel_y >= 0 && pixel_y < view->sc_height)
+            orbit_pixels[points_num++] = (size_t)pixel_y * view->sc_width + (size_t)pixel_x;
+
+        float x2   = x * x;
+        float y2   = y * y;
+        float _2xy = 2 * x * y;
+
+        #ifdef BURNING_SHIP
+            _2xy = fabsf(_2xy);
+        #endif
+
+        x = x2 - y2 + x0;
+        y = _2xy + y0;
+    }
+
+    return points_num;
+}
+
+/// @brief adds replayed orbit with weight into histograms of channels which limits are bigger than its escape number
+static void addOrbit(buddha_thread_t * thread, const uint32_t num, const size_t orbit_len, const float weight)
+{
+    assert(thread);
+
+    const size_t channels_num = thread->params->is_nebula ? MAX_CHANNELS_NUM : 1;
+    const size_t pixels_num   = (size_t)thread->md->sc_width * thread->md->sc_height;
+
+    for (size_t channel = 0; channel < channels_num; channel++){
+        if (num >= limitOfChannel(thread->params, thread->md, channel))
+            continue;
+
+        float * histogram = thread->histogram + channel * pixels_num;
+
+        for (size_t point_index = 0; point_index < orbit_len; point_index++){
+            histogram[thread->orbit_pixels[point_index]] += weight;
+        }
+    }
+
+    thread->orbits++;
+    thread->points += orbit_len;
+}
+
+/// @brief density is mapped by square root: one channel through the color table (empty pixels are black),
+///        three channels directly into red, green and blue
+static void toneMap(const mandelbrot_context_t * md, const float * histogram, const size_t channels_num)
+{
+    assert(md);
+    assert(histogram);
+
+    const size_t pixels_num = (size_t)md->sc_width * md->sc_height;
+
+    float max_density[MAX_CHANNELS_NUM] = {};
+
+    for (size_t channel = 0; channel < channels_num; channel++){
+        for (size_t index = 0; index < pixels_num; index++){
+            if (histogram[channel * pixels_num + index] > max_density[channel])
+                max_density[channel] = histogram[channel * pixels_num + index];
+        }
+
+        if (max_density[channel] == 0)
+            max_density[channel] = 1;
+    }
+
+    if (channels_num == 1){
+        // COLOR_TABLE_LEN is never reached by tone mapped density, so it is used as the limit for empty pixels
+        mandelbrot_context_t tone_md = *md;
+        tone_md.iter_num = COLOR_TABLE_LEN;
+
+        for (size_t index = 0; index < pixels_num; index++){
+            float tone = sqrtf(histogram[index] / max_density[0]);
+
+            md->num_pixels[index] = (histogram[index] == 0) ? COLOR_TABLE_LEN : 1 + (uint32_t)(tone * (COLOR_TABLE_LEN - 2));
+        }
+
+        numsToColor(&tone_md);
+        return;
+    }
+
+    for (size_t index = 0; index < pixels_num; index++){
+        uint32_t color = 0xFFu << 24;
+
+        // it is rgba in sfml
+        for (size_t channel = 0; channel < MAX_CHANNELS_NUM; channel++){
+            float tone = sqrtf(histogram[channel * pixels_num + index] / max_density[channel]);
+            color |= (uint32_t)(tone * 255) << (8 * channel);
+        }
+
+        md->color_pixels[index] = color;
+    }
+}
+
+static uint32_t limitOfChannel(const buddhabrot_params_t * params, const mandelbrot_context_t * md, const size_t channel)
+{
+    assert(params);
+    assert(md);
+
+    return params->is_nebula ? NEBULA_ITER_NUMS[channel] : md->iter_num;
+}
+
+/// @brief xorshift64* in [0, 1)
+static float randFloat(uint64_t * state)
+{
+    assert(state);
+
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+
+    return ((*state * 0x2545F4914F6CDD1Dull) >> 40) * (1.f / (1 << 24));
+}
+
+/// @brief standard normal distribution (Box-Muller)
+static float randGauss(uint64_t * state)
+{
+    float u1 = randFloat(state) + 1e-7f;
+    float u2 = randFloat(state);
+
+    return sqrtf(-2 * logf(u1)) * cosf(2 * (float)M_PI * u2);
+}
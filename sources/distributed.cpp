@@ -0,0 +1,828 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <assert.h>
+
+#include "distributed.h"
+#include "mandelbrot.h"
+#include "frame_alloc.h"
+
+// both sides are expected to have the same byte order
+const uint32_t REQUEST_MAGIC = 0x5144444D;     // "MDDQ"
+const uint32_t ANSWER_MAGIC  = 0x4144444D;     // "MDDA"
+
+// poll timeout, speculation and worker timeouts are checked this often
+const int POLL_PERIOD_MS = 20;
+
+const int CONNECT_RETRIES_NUM = 50;
+
+// local workers are run by default as this program
+const char * const SELF_EXE_PATH = "/proc/self/exe";
+
+extern char ** environ;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t frame_id;
+    uint32_t tile_id;
+
+    float center_x;
+    float center_y;
+    float scale;
+    uint32_t iter_num;
+
+    uint32_t width;
+    uint32_t height;
+    uint32_t row_begin;
+    uint32_t row_end;
+} tile_request_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t frame_id;
+    uint32_t tile_id;
+
+    uint32_t width;
+    uint32_t row_begin;
+    uint32_t row_end;
+
+    double calc_time;       // in ms
+} tile_answer_t;
+
+typedef enum {
+    TILE_PENDING = 0,
+    TILE_RUNNING,
+    TILE_DONE
+} tile_state_t;
+
+typedef struct {
+    tile_state_t state;
+    uint32_t copies;        // workers which calculate the tile now
+    double start_time;      // when the first copy was sent
+} tile_info_t;
+
+typedef struct {
+    int fd;
+    bool is_alive;
+
+    // tiles sent and not answered yet (answers come in the same order) and frame sizes of their requests
+    uint32_t inflight_frames [WORKER_PIPELINE_DEPTH];
+    uint32_t inflight_tiles  [WORKER_PIPELINE_DEPTH];
+    uint32_t inflight_widths [WORKER_PIPELINE_DEPTH];
+    uint32_t inflight_heights[WORKER_PIPELINE_DEPTH];
+    size_t inflight_num;
+
+    double last_activity;   // in ms
+
+    // answer which is being received
+    tile_answer_t answer;
+    size_t answer_got;
+
+    uint32_t * payload;
+    size_t payload_got;
+    size_t payload_capacity;
+
+    worker_stats_t stats;
+} worker_t;
+
+struct coordinator {
+    coordinator_params_t params;
+
+    int listen_fd;
+    uint16_t port;
+
+    pid_t local_pids[MAX_WORKERS_NUM];
+    size_t local_num;
+
+    worker_t workers[MAX_WORKERS_NUM];
+    size_t workers_num;
+
+    uint32_t frame_id;
+    bool is_started;        // min_workers_num workers have connected once
+
+    // state of the current frame
+    mandelbrot_context_t * md;
+    tile_info_t * tiles;
+    uint32_t tiles_num;
+    uint32_t done_num;
+
+    double tile_time_sum;
+    size_t tile_time_num;
+
+    coordinator_stats_t * stats;
+};
+
+static double nowMs();
+
+static bool writeAll(int fd, const void * buffer, size_t len);
+
+static bool readAll(int fd, void * buffer, size_t len);
+
+static void setNoDelay(int fd);
+
+static void spawnLocalWorkers(coordinator_t * coord);
+
+static size_t aliveWorkersNum(const coordinator_t * coord);
+
+static void acceptWorker(coordinator_t * coord);
+
+static void killWorker(coordinator_t * coord, worker_t * worker);
+
+static void assignTiles(coordinator_t * coord);
+
+static int takeTile(coordinator_t * coord, const worker_t * worker);
+
+static bool sendTile(coordinator_t * coord, worker_t * worker, const uint32_t tile_id);
+
+static void receiveAnswer(coordinator_t * coord, worker_t * worker);
+
+static bool isAnswerExpected(const worker_t * worker);
+
+static void handleAnswer(coordinator_t * coord, worker_t * worker);
+
+
+coordinator_t * coordinatorCtor(const coordinator_params_t * params)
+{
+    assert(params);
+    assert(params->local_workers_num <= MAX_WORKERS_NUM);
+
+    coordinator_t * coord = (coordinator_t *)calloc(1, sizeof(*coord));
+    if (! coord){
+        fprintf(stderr, "ERROR: Could not allocate memory for coordinator\n");
+        return NULL;
+    }
+
+    coord->params = *params;
+
+    // spawned workers do not inherit sockets of the coordinator
+    coord->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    int reuse = 1;
+    setsockopt(coord->listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr = {};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = htons(params->port);
+
+    if (params->bind_address && inet_pton(AF_INET, params->bind_address, &addr.sin_addr) != 1){
+        fprintf(stderr, "ERROR: Incorrect bind address '%s'\n", params->bind_address);
+
+        if (coord->listen_fd >= 0)
+            close(coord->listen_fd);
+        free(coord);
+        return NULL;
+    }
+
+    if (coord->listen_fd < 0 || bind(coord->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+                             || listen(coord->listen_fd, MAX_WORKERS_NUM) < 0){
+        fprintf(stderr, "ERROR: Could not listen on port %u (%s)\n", params->port, strerror(errno));
+
+        if (coord->listen_fd >= 0)
+            close(coord->listen_fd);
+        free(coord);
+        return NULL;
+    }
+
+    socklen_t addr_len = sizeof(addr);
+    getsockname(coord->listen_fd, (struct sockaddr *)&addr, &addr_len);
+    coord->port = ntohs(addr.sin_port);
+
+    spawnLocalWorkers(coord);
+
+    return coord;
+}
+
+uint16_t coordinatorPort(const coordinator_t * coord)
+{
+    assert(coord);
+
+    return coord->port;
+}
+
+void coordinatorDtor(coordinator_t * coord)
+{
+    assert(coord);
+
+    // workers exit as soon as they see the end of the connection
+    for (size_t worker_index = 0; worker_index < coord->workers_num; worker_index++){
+        if (coord->workers[worker_index].is_alive)
+            close(coord->workers[worker_index].fd);
+
+        frameFree(coord->workers[worker_index].payload);
+    }
+
+    close(coord->listen_fd);
+
+    for (size_t local_index = 0; local_index < coord->local_num; local_index++){
+        waitpid(coord->local_pids[local_index], NULL, 0);
+    }
+
+    free(coord);
+}
+
+bool coordinatorRender(coordinator_t * coord, mandelbrot_context_t * md, coordinator_stats_t * stats)
+{
+    assert(coord);
+    assert(md);
+    assert(stats);
+
+    memset(stats, 0, sizeof(*stats));
+
+    const double render_start = nowMs();
+
+    coord->frame_id++;
+    coord->md    = md;
+    coord->stats = stats;
+
+    coord->tiles_num = (md->sc_height + DIST_TILE_ROWS - 1) / DIST_TILE_ROWS;
+    coord->done_num  = 0;
+    coord->tiles     = (tile_info_t *)calloc(coord->tiles_num, sizeof(*coord->tiles));
+
+    if (! coord->tiles){
+        fprintf(stderr, "ERROR: Could not allocate memory for tiles of the frame\n");
+        return false;
+    }
+
+    coord->tile_time_sum = 0;
+    coord->tile_time_num = 0;
+
+    for (size_t worker_index = 0; worker_index < coord->workers_num; worker_index++){
+        memset(&coord->workers[worker_index].stats.tiles, 0, sizeof(worker_stats_t) - offsetof(worker_stats_t, tiles));
+        coord->workers[worker_index].stats.is_dead = ! coord->workers[worker_index].is_alive;
+    }
+
+    double no_workers_since = nowMs();
+
+    while (coord->done_num < coord->tiles_num){
+        const size_t alive_num = aliveWorkersNum(coord);
+        // workers which die later do not stop rendering
+        if (alive_num >= coord->params.min_workers_num || nowMs() - render_start > CONNECT_TIMEOUT_MS)
+            coord->is_started = true;
+
+        if (alive_num > 0)
+            no_workers_since = nowMs();
+        else if (nowMs() - no_workers_since > CONNECT_TIMEOUT_MS){
+            fprintf(stderr, "ERROR: No workers are connected, frame is not rendered\n");
+            break;
+        }
+
+        if (coord->is_started)
+            assignTiles(coord);
+
+        struct pollfd poll_fds[MAX_WORKERS_NUM + 1] = {};
+        worker_t * poll_workers[MAX_WORKERS_NUM + 1] = {};
+        size_t poll_num = 0;
+
+        poll_fds[poll_num].fd     = coord->listen_fd;
+        poll_fds[poll_num].events = POLLIN;
+        poll_num++;
+
+        for (size_t worker_index = 0; worker_index < coord->workers_num; worker_index++){
+            worker_t * worker = coord->workers + worker_index;
+
+            if (! worker->is_alive)
+                continue;
+
+            poll_fds[poll_num].fd     = worker->fd;
+            poll_fds[poll_num].events = POLLIN;
+            poll_workers[poll_num]    = worker;
+            poll_num++;
+        }
+
+        poll(poll_fds, poll_num, POLL_PERIOD_MS);
+
+        if (poll_fds[0].revents & POLLIN)
+            acceptWorker(coord);
+
+        for (size_t poll_index = 1; poll_index < poll_num; poll_index++){
+            if (poll_fds[poll_index].revents & (POLLIN | POLLHUP | POLLERR))
+                receiveAnswer(coord, poll_workers[poll_index]);
+        }
+
+        // silent workers are considered dead
+        for (size_t worker_index = 0; worker_index < coord->workers_num; worker_index++){
+            worker_t * worker = coord->workers + worker_index;
+
+            if (worker->is_alive && worker->inflight_num > 0 && nowMs() - worker->last_activity > WORKER_TIMEOUT_MS){
+                fprintf(stderr, "ERROR: Worker %s is not answering, its tiles are given to others\n", worker->stats.name);
+                killWorker(coord, worker);
+            }
+        }
+    }
+
+    const bool is_rendered = coord->done_num == coord->tiles_num;
+
+    free(coord->tiles);
+    coord->tiles = NULL;
+
+    stats->tiles = coord->tiles_num;
+    stats->time  = nowMs() - render_start;
+
+    stats->workers_num = coord->workers_num;
+    for (size_t worker_index = 0; worker_index < coord->workers_num; worker_index++){
+        stats->workers[worker_index] = coord->workers[worker_index].stats;
+    }
+
+    return is_rendered;
+}
+
+int runWorker(const char * host, const uint16_t port)
+{
+    assert(host);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(port);
+
+    if (fd < 0 || inet_pton(AF_INET, host, &addr.sin_addr) != 1){
+        fprintf(stderr, "ERROR: Incorrect coordinator address '%s'\n", host);
+        return 1;
+    }
+
+    // coordinator can be started a bit later than the worker
+    int connect_result = -1;
+    for (int retry = 0; retry < CONNECT_RETRIES_NUM && connect_result < 0; retry++){
+        connect_result = connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+
+        if (connect_result < 0)
+            usleep(100000);
+    }
+
+    if (connect_result < 0){
+        fprintf(stderr, "ERROR: Could not connect to coordinator %s:%u (%s)\n", host, port, strerror(errno));
+        close(fd);
+        return 1;
+    }
+
+    setNoDelay(fd);
+
+    mandelbrot_context_t md = {};
+
+    uint32_t * tile_pixels = NULL;
+    size_t tile_capacity = 0;
+
+    tile_request_t request = {};
+
+    while (readAll(fd, &request, sizeof(request))){
+        if (request.magic != REQUEST_MAGIC || request.row_begin > request.row_end || request.row_end > request.height ||
+            request.row_end - request.row_begin > DIST_TILE_ROWS || request.width > MAX_DIST_WIDTH){
+            fprintf(stderr, "ERROR: Incorrect tile request from coordinator\n");
+            break;
+        }
+
+        const size_t tile_len = (size_t)(request.row_end - request.row_begin) * request.width;
+
+        if (tile_len > tile_capacity){
+            frameFree(tile_pixels);
+            tile_pixels   = (uint32_t *)frameAlloc((tile_len + FRAME_PADDING_PIXELS) * sizeof(uint32_t), 1);
+            tile_capacity = tile_len;
+
+            if (! tile_pixels)
+                break;
+        }
+
+        md.center_x  = request.center_x;
+        md.center_y  = request.center_y;
+        md.scale     = request.scale;
+        md.iter_num  = request.iter_num;
+        md.sc_width  = request.width;
+        md.sc_height = request.height;
+
+        tile_answer_t answer = {
+            .magic     = ANSWER_MAGIC,
+            .frame_id  = request.frame_id,
+            .tile_id   = request.tile_id,
+            .width     = request.width,
+            .row_begin = request.row_begin,
+            .row_end   = request.row_end,
+            .calc_time = 0
+        };
+
+        const double calc_start = nowMs();
+        calcMandelbrotConveyorTile(&md, request.row_begin, request.row_end, tile_pixels);
+        answer.calc_time = nowMs() - calc_start;
+
+        if (! writeAll(fd, &answer, sizeof(answer)) || ! writeAll(fd, tile_pixels, tile_len * sizeof(uint32_t)))
+            break;
+    }
+
+    frameFree(tile_pixels);
+    close(fd);
+
+    return 0;
+}
+
+static double nowMs()
+{
+    struct timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return 1000. * now.tv_sec + now.tv_nsec / 1e6;
+}
+
+static bool writeAll(int fd, const void * buffer, size_t len)
+{
+    const char * data = (const char *)buffer;
+
+    while (len > 0){
+        ssize_t written = send(fd, data, len, MSG_NOSIGNAL);
+
+        if (written < 0 && errno == EINTR)
+            continue;
+
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+            struct pollfd poll_fd = {.fd = fd, .events = POLLOUT, .revents = 0};
+            poll(&poll_fd, 1, POLL_PERIOD_MS);
+            continue;
+        }
+
+        if (written <= 0)
+            return false;
+
+        data += written;
+        len  -= written;
+    }
+
+    return true;
+}
+
+static bool readAll(int fd, void * buffer, size_t len)
+{
+    char * data = (char *)buffer;
+
+    while (len > 0){
+        ssize_t got = recv(fd, data, len, 0);
+
+        if (got < 0 && errno == EINTR)
+            continue;
+
+        if (got <= 0)
+            return false;
+
+        data += got;
+        len  -= got;
+    }
+
+    return true;
+}
+
+static void setNoDelay(int fd)
+{
+    int no_delay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+}
+
+/// @brief runs local workers as new processes: forked copy of a multithreaded program could deadlock
+///        on locks (of the arena, stdio) held by its other threads, so the worker program is executed from the start
+static void spawnLocalWorkers(coordinator_t * coord)
+{
+    assert(coord);
+
+    const char * worker_path = coord->params.worker_path ? coord->params.worker_path : SELF_EXE_PATH;
+
+    char port_str[8] = "";
+    snprintf(port_str, sizeof(port_str), "%u", coord->port);
+
+    char * const worker_argv[] = {(char *)worker_path, (char *)"-w", (char *)"127.0.0.1", port_str, NULL};
+
+    for (size_t local_index = 0; local_index < coord->params.local_workers_num; local_index++){
+        pid_t pid = 0;
+
+        int error = posix_spawn(&pid, worker_path, NULL, NULL, worker_argv, environ);
+        if (error){
+            fprintf(stderr, "ERROR: Could not start local worker '%s' (%s)\n", worker_path, strerror(error));
+            break;
+        }
+
+        coord->local_pids[coord->local_num++] = pid;
+    }
+}
+
+static size_t aliveWorkersNum(const coordinator_t * coord)
+{
+    assert(coord);
+
+    size_t alive_num = 0;
+
+    for (size_t worker_index = 0; worker_index < coord->workers_num; worker_index++){
+        if (coord->workers[worker_index].is_alive)
+            alive_num++;
+    }
+
+    return alive_num;
+}
+
+static void acceptWorker(coordinator_t * coord)
+{
+    assert(coord);
+
+    struct sockaddr_in addr = {};
+    socklen_t addr_len = sizeof(addr);
+
+    int fd = accept4(coord->listen_fd, (struct sockaddr *)&addr, &addr_len, SOCK_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    if (coord->workers_num == MAX_WORKERS_NUM){
+        fprintf(stderr, "ERROR: Too many workers (%zu), new one is refused\n", MAX_WORKERS_NUM);
+        close(fd);
+        return;
+    }
+
+    setNoDelay(fd);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    worker_t * worker = coord->workers + coord->workers_num++;
+    memset(worker, 0, sizeof(*worker));
+
+    worker->fd       = fd;
+    worker->is_alive = true;
+    worker->last_activity = nowMs();
+
+    char host[INET_ADDRSTRLEN] = {};
+    inet_ntop(AF_INET, &addr.sin_addr, host, sizeof(host));
+    snprintf(worker->stats.name, sizeof(worker->stats.name), "%s:%u", host, ntohs(addr.sin_port));
+}
+
+/// @brief closes connection with the worker, its tiles of the current frame are given to others
+static void killWorker(coordinator_t * coord, worker_t * worker)
+{
+    assert(coord);
+    assert(worker);
+
+    close(worker->fd);
+    worker->is_alive      = false;
+    worker->stats.is_dead = true;
+
+    for (size_t inflight_index = 0; inflight_index < worker->inflight_num; inflight_index++){
+        if (worker->inflight_frames[inflight_index] != coord->frame_id || ! coord->tiles)
+            continue;
+
+        tile_info_t * tile = coord->tiles + worker->inflight_tiles[inflight_index];
+        tile->copies--;
+
+        if (tile->state == TILE_RUNNING && tile->copies == 0){
+            tile->state = TILE_PENDING;
+            coord->stats->retried_tiles++;
+        }
+    }
+
+    worker->inflight_num = 0;
+}
+
+/// @brief fills pipelines of all alive workers: fast workers answer more often, so they take more tiles
+static void assignTiles(coordinator_t * coord)
+{
+    assert(coord);
+
+    for (size_t worker_index = 0; worker_index < coord->workers_num; worker_index++){
+        worker_t * worker = coord->workers + worker_index;
+
+        while (worker->is_alive && worker->inflight_num < WORKER_PIPELINE_DEPTH){
+            int tile_id = takeTile(coord, worker);
+            if (tile_id < 0)
+                break;
+
+            if (! sendTile(coord, worker, tile_id))
+                killWorker(coord, worker);
+        }
+    }
+}
+
+/// @brief first pending tile, or (for idle worker when nothing is pending) the oldest tile which runs too long
+static int takeTile(coordinator_t * coord, const worker_t * worker)
+{
+    assert(coord);
+    assert(worker);
+
+    for (uint32_t tile_id = 0; tile_id < coord->tiles_num; tile_id++){
+        if (coord->tiles[tile_id].state == TILE_PENDING)
+            return tile_id;
+    }
+
+    if (worker->inflight_num > 0 || coord->tile_time_num == 0)
+        return -1;
+
+    const double mean_tile_time = coord->tile_time_sum / coord->tile_time_num;
+    const double now = nowMs();
+
+    int slowest_tile = -1;
+
+    for (uint32_t tile_id = 0; tile_id < coord->tiles_num; tile_id++){
+        const tile_info_t * tile = coord->tiles + tile_id;
+
+        if (tile->state != TILE_RUNNING || tile->copies > 1 || now - tile->start_time < SPECULATION_COEF * mean_tile_time)
+            continue;
+
+        if (slowest_tile < 0 || tile->start_time < coord->tiles[slowest_tile].start_time)
+            slowest_tile = tile_id;
+    }
+
+    // the worker which calculates the tile now may be asked to calculate it again
+    for (size_t inflight_index = 0; slowest_tile >= 0 && inflight_index < worker->inflight_num; inflight_index++){
+        if (worker->inflight_tiles[inflight_index] == (uint32_t)slowest_tile)
+            return -1;
+    }
+
+    if (slowest_tile >= 0)
+        coord->stats->speculative_tiles++;
+
+    return slowest_tile;
+}
+
+static bool sendTile(coordinator_t * coord, worker_t * worker, const uint32_t tile_id)
+{
+    assert(coord);
+    assert(worker);
+
+    const mandelbrot_context_t * md = coord->md;
+    tile_info_t * tile = coord->tiles + tile_id;
+
+    const uint32_t row_begin = tile_id * DIST_TILE_ROWS;
+    const uint32_t row_end   = (row_begin + DIST_TILE_ROWS < md->sc_height) ? row_begin + DIST_TILE_ROWS : md->sc_height;
+
+    tile_request_t request = {
+        .magic     = REQUEST_MAGIC,
+        .frame_id  = coord->frame_id,
+        .tile_id   = tile_id,
+        .center_x  = md->center_x,
+        .center_y  = md->center_y,
+        .scale     = md->scale,
+        .iter_num  = md->iter_num,
+        .width     = md->sc_width,
+        .height    = md->sc_height,
+        .row_begin = row_begin,
+        .row_end   = row_end
+    };
+
+    if (! writeAll(worker->fd, &request, sizeof(request)))
+        return false;
+
+    if (tile->state == TILE_PENDING){
+        tile->state      = TILE_RUNNING;
+        tile->start_time = nowMs();
+    }
+    tile->copies++;
+
+    if (worker->inflight_num == 0)
+        worker->last_activity = nowMs();
+
+    worker->inflight_frames [worker->inflight_num] = coord->frame_id;
+    worker->inflight_tiles  [worker->inflight_num] = tile_id;
+    worker->inflight_widths [worker->inflight_num] = md->sc_width;
+    worker->inflight_heights[worker->inflight_num] = md->sc_height;
+    worker->inflight_num++;
+
+    return true;
+}
+
+/// @brief reads available part of the answer (sockets of workers are non blocking)
+static void receiveAnswer(coordinator_t * coord, worker_t * worker)
+{
+    assert(coord);
+    assert(worker);
+
+    while (worker->is_alive){
+        char * dest = NULL;
+        size_t left = 0;
+
+        if (worker->answer_got < sizeof(worker->answer)){
+            dest = (char *)&worker->answer + worker->answer_got;
+            left = sizeof(worker->answer) - worker->answer_got;
+        }
+        else {
+            dest = (char *)worker->payload + worker->payload_got;
+            left = (size_t)(worker->answer.row_end - worker->answer.row_begin) * worker->answer.width * sizeof(uint32_t) - worker->payload_got;
+        }
+
+        ssize_t got = (left > 0) ? recv(worker->fd, dest, left, 0) : 0;
+
+        if (left > 0 && got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            return;
+
+        if (left > 0 && got <= 0){
+            fprintf(stderr, "ERROR: Worker %s disconnected\n", worker->stats.name);
+            killWorker(coord, worker);
+            return;
+        }
+
+        worker->last_activity = nowMs();
+
+        if (worker->answer_got < sizeof(worker->answer)){
+            worker->answer_got += got;
+
+            if (worker->answer_got < sizeof(worker->answer))
+                continue;
+
+            if (! isAnswerExpected(worker)){
+                fprintf(stderr, "ERROR: Incorrect answer from worker %s\n", worker->stats.name);
+                killWorker(coord, worker);
+                return;
+            }
+
+            // answer is the tile of the request, so the payload is never bigger than DIST_TILE_ROWS rows of the frame
+            const size_t payload_size = (size_t)(worker->answer.row_end - worker->answer.row_begin) * worker->answer.width * sizeof(uint32_t);
+
+            if (payload_size > worker->payload_capacity){
+                frameFree(worker->payload);
+                worker->payload = (uint32_t *)frameAlloc(payload_size, 1);
+                worker->payload_capacity = worker->payload ? payload_size : 0;
+
+                if (! worker->payload){
+                    killWorker(coord, worker);
+                    return;
+                }
+            }
+        }
+        else
+            worker->payload_got += got;
+
+        const size_t payload_size = (size_t)(worker->answer.row_end - worker->answer.row_begin) * worker->answer.width * sizeof(uint32_t);
+
+        if (worker->payload_got == payload_size){
+            handleAnswer(coord, worker);
+
+            worker->answer_got  = 0;
+            worker->payload_got = 0;
+        }
+    }
+}
+
+/// @brief answer header is the one of the oldest request sent to the worker: same frame and tile,
+///        width of the frame and rows of the tile
+static bool isAnswerExpected(const worker_t * worker)
+{
+    assert(worker);
+
+    const tile_answer_t * answer = &worker->answer;
+
+    if (answer->magic != ANSWER_MAGIC || worker->inflight_num == 0 ||
+        answer->tile_id != worker->inflight_tiles[0] || answer->frame_id != worker->inflight_frames[0])
+        return false;
+
+    const uint32_t row_begin = answer->tile_id * DIST_TILE_ROWS;
+    const uint32_t row_end   = (row_begin + DIST_TILE_ROWS < worker->inflight_heights[0]) ? row_begin + DIST_TILE_ROWS : worker->inflight_heights[0];
+
+    return answer->width == worker->inflight_widths[0] && answer->row_begin == row_begin && answer->row_end == row_end;
+}
+
+/// @brief puts received tile into the frame, if it is not there yet (tiles of previous frames and late copies are dropped)
+static void handleAnswer(coordinator_t * coord, worker_t * worker)
+{
+    assert(coord);
+    assert(worker);
+
+    const tile_answer_t * answer = &worker->answer;
+
+    worker->inflight_num--;
+    memmove(worker->inflight_frames,  worker->inflight_frames  + 1, worker->inflight_num * sizeof(uint32_t));
+    memmove(worker->inflight_tiles,   worker->inflight_tiles   + 1, worker->inflight_num * sizeof(uint32_t));
+    memmove(worker->inflight_widths,  worker->inflight_widths  + 1, worker->inflight_num * sizeof(uint32_t));
+    memmove(worker->inflight_heights, worker->inflight_heights + 1, worker->inflight_num * sizeof(uint32_t));
+
+    if (answer->frame_id != coord->frame_id)
+        return;
+
+    tile_info_t * tile = coord->tiles + answer->tile_id;
+    tile->copies--;
+
+    if (tile->state == TILE_DONE)
+        return;
+
+    mandelbrot_context_t * md = coord->md;
+    const size_t tile_len = (size_t)(answer->row_end - answer->row_begin) * answer->width;
+
+    // answers of the current frame are checked against its size by isAnswerExpected
+    assert(answer->width == md->sc_width && answer->row_end <= md->sc_height);
+
+    memcpy(md->num_pixels + (size_t)answer->row_begin * md->sc_width, worker->payload, tile_len * sizeof(uint32_t));
+
+    tile->state = TILE_DONE;
+    coord->done_num++;
+
+    coord->tile_time_sum += nowMs() - tile->start_time;
+    coord->tile_time_num++;
+
+    worker->stats.tiles++;
+    worker->stats.pixels    += tile_len;
+    worker->stats.busy_time += answer->calc_time;
+
+    if (coord->params.tile_callback)
+        coord->params.tile_callback(md, answer->row_begin, answer->row_end, coord->params.callback_arg);
+}
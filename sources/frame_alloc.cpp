@@ -0,0 +1,384 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <assert.h>
+
+#include "frame_alloc.h"
+
+typedef struct {
+    void * buffer;
+    size_t capacity;
+
+    // pages are placed by touch_parts threads for the buffer of touch_size bytes (touch_parts is 1 if they are not placed)
+    size_t touch_parts;
+    size_t touch_size;
+
+    bool is_mapped;
+    bool is_used;
+} arena_block_t;
+
+typedef struct {
+    char * start;
+    size_t len;
+
+    size_t thread_index;
+} touch_task_t;
+
+// buffers are first touched by no more threads than this
+static const size_t MAX_TOUCH_THREADS = 32;
+
+static arena_block_t arena[FRAME_ARENA_SIZE] = {};
+static pthread_mutex_t arena_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static bool is_pinning_on = false;
+
+// cpus allowed for the process, cpus of one NUMA node go one after another
+static int pin_cpus[CPU_SETSIZE] = {};
+static size_t pin_cpus_num = 0;
+static pthread_once_t pin_cpus_once = PTHREAD_ONCE_INIT;
+
+static size_t placementParts(const size_t size, const size_t touch_parts);
+
+static arena_block_t * findFreeBlock(const size_t size, const size_t touch_parts);
+
+static bool allocBlock(arena_block_t * block, const size_t size);
+
+static void freeBlock(arena_block_t * block);
+
+static void firstTouch(void * buffer, const size_t size, const size_t touch_len, const size_t touch_parts);
+
+static void * threadTouch(void * task_ptr);
+
+static void initPinCpus();
+
+static void addNodeCpus(FILE * cpulist_file, const cpu_set_t * allowed, bool * is_listed);
+
+
+void * frameAlloc(const size_t size, const size_t touch_parts)
+{
+    const size_t placed_parts = placementParts(size, touch_parts);
+
+    pthread_mutex_lock(&arena_mutex);
+
+    arena_block_t * block = findFreeBlock(size, placed_parts);
+
+    if (block){
+        block->is_used = true;
+        pthread_mutex_unlock(&arena_mutex);
+
+        // pages of a reused buffer are placed for the same bands, every band is cleared by the thread of its node
+        if (block->touch_parts > 1)
+            firstTouch(block->buffer, size, size, block->touch_parts);
+        else
+            memset(block->buffer, 0, size);
+
+        return block->buffer;
+    }
+
+    // looking for an empty slot, if there is none the biggest free buffer is given back to the system
+    for (size_t block_index = 0; block_index < FRAME_ARENA_SIZE; block_index++){
+        if (! arena[block_index].buffer){
+            block = arena + block_index;
+            break;
+        }
+
+        if (! arena[block_index].is_used && (! block || arena[block_index].capacity > block->capacity))
+            block = arena + block_index;
+    }
+
+    if (! block){
+        pthread_mutex_unlock(&arena_mutex);
+        fprintf(stderr, "ERROR: Frame arena is full (%zu buffers are used)\n", FRAME_ARENA_SIZE);
+        return NULL;
+    }
+
+    if (block->buffer)
+        freeBlock(block);
+
+    if (! allocBlock(block, size)){
+        pthread_mutex_unlock(&arena_mutex);
+        fprintf(stderr, "ERROR: Could not allocate frame buffer of %zu bytes\n", size);
+        return NULL;
+    }
+
+    block->is_used     = true;
+    block->touch_parts = placed_parts;
+    block->touch_size  = size;
+
+    pthread_mutex_unlock(&arena_mutex);
+
+    firstTouch(block->buffer, size, block->capacity, placed_parts);
+
+    return block->buffer;
+}
+
+void frameFree(void * buffer)
+{
+    if (! buffer)
+        return;
+
+    pthread_mutex_lock(&arena_mutex);
+
+    for (size_t block_index = 0; block_index < FRAME_ARENA_SIZE; block_index++){
+        if (arena[block_index].buffer == buffer){
+            assert(arena[block_index].is_used);
+            arena[block_index].is_used = false;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&arena_mutex);
+}
+
+void frameArenaRelease()
+{
+    pthread_mutex_lock(&arena_mutex);
+
+    for (size_t block_index = 0; block_index < FRAME_ARENA_SIZE; block_index++){
+        if (arena[block_index].buffer && ! arena[block_index].is_used)
+            freeBlock(arena + block_index);
+    }
+
+    pthread_mutex_unlock(&arena_mutex);
+}
+
+void setThreadPinning(const bool is_on)
+{
+    is_pinning_on = is_on;
+}
+
+bool bindThreadToCpu(const size_t thread_index)
+{
+    if (! is_pinning_on)
+        return false;
+
+    pthread_once(&pin_cpus_once, initPinCpus);
+
+    if (pin_cpus_num <= 1)
+        return false;
+
+    const int cpu = pin_cpus[thread_index % pin_cpus_num];
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    if (error){
+        fprintf(stderr, "ERROR: Could not bind thread %zu to cpu %d: %s\n", thread_index, cpu, strerror(error));
+        return false;
+    }
+
+    return true;
+}
+
+/// @brief number of threads the pages of the new buffer are placed by (1 if the buffer is cleared by the calling thread)
+static size_t placementParts(const size_t size, const size_t touch_parts)
+{
+    if (touch_parts <= 1 || touch_parts > MAX_TOUCH_THREADS || size < HUGE_PAGE_SIZE)
+        return 1;
+
+    return touch_parts;
+}
+
+/// @brief smallest free buffer which can hold size bytes and is not more than twice bigger;
+///        buffer for placed bands is taken only if its pages were placed for the same bands
+static arena_block_t * findFreeBlock(const size_t size, const size_t touch_parts)
+{
+    arena_block_t * best_block = NULL;
+
+    for (size_t block_index = 0; block_index < FRAME_ARENA_SIZE; block_index++){
+        arena_block_t * block = arena + block_index;
+
+        if (! block->buffer || block->is_used)
+            continue;
+
+        if (block->capacity < size || block->capacity > 2 * size + HUGE_PAGE_SIZE)
+            continue;
+
+        if (touch_parts > 1 && (block->touch_parts != touch_parts || block->touch_size != size))
+            continue;
+
+        if (! best_block || block->capacity < best_block->capacity)
+            best_block = block;
+    }
+
+    return best_block;
+}
+
+static bool allocBlock(arena_block_t * block, const size_t size)
+{
+    assert(block);
+
+    if (size >= HUGE_PAGE_SIZE){
+        size_t capacity = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+      #ifdef EXPLICIT_HUGE_PAGES
+        flags |= MAP_HUGETLB;
+      #endif
+
+        void * buffer = mmap(NULL, capacity, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (buffer == MAP_FAILED)
+            return false;
+
+      #ifndef EXPLICIT_HUGE_PAGES
+        madvise(buffer, capacity, MADV_HUGEPAGE);
+      #endif
+
+        block->buffer    = buffer;
+        block->capacity  = capacity;
+        block->is_mapped = true;
+
+        return true;
+    }
+
+    size_t capacity = (size + FRAME_ALIGNMENT - 1) / FRAME_ALIGNMENT * FRAME_ALIGNMENT;
+
+    block->buffer    = aligned_alloc(FRAME_ALIGNMENT, capacity);
+    block->capacity  = capacity;
+    block->is_mapped = false;
+
+    return block->buffer != NULL;
+}
+
+static void freeBlock(arena_block_t * block)
+{
+    assert(block);
+
+    if (block->is_mapped)
+        munmap(block->buffer, block->capacity);
+    else
+        free(block->buffer);
+
+    memset(block, 0, sizeof(*block));
+}
+
+/// @brief clears touch_len bytes of the buffer by touch_parts threads, the bands of the buffer of size bytes
+///        go to the threads (so pages of a new buffer are placed on their nodes)
+static void firstTouch(void * buffer, const size_t size, const size_t touch_len, const size_t touch_parts)
+{
+    assert(buffer);
+
+    if (touch_parts <= 1){
+        memset(buffer, 0, touch_len);
+        return;
+    }
+
+    touch_task_t tasks[MAX_TOUCH_THREADS] = {};
+    pthread_t threads[MAX_TOUCH_THREADS] = {};
+
+    // part bounds are the bounds of row bands rounded to the nearest huge page, so a page is touched
+    // by the worker which renders most of it (the tail up to touch_len goes to the last one)
+    size_t part_begin = 0;
+
+    for (size_t thread_index = 0; thread_index < touch_parts; thread_index++){
+        size_t part_end = touch_len;
+
+        if (thread_index + 1 < touch_parts){
+            part_end = size / touch_parts * (thread_index + 1) + size % touch_parts * (thread_index + 1) / touch_parts;
+            part_end = (part_end + HUGE_PAGE_SIZE / 2) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+
+            if (part_end < part_begin)
+                part_end = part_begin;
+            if (part_end > touch_len)
+                part_end = touch_len;
+        }
+
+        tasks[thread_index].start = (char *)buffer + part_begin;
+        tasks[thread_index].len   = part_end - part_begin;
+        tasks[thread_index].thread_index = thread_index;
+
+        part_begin = part_end;
+
+        pthread_create(threads + thread_index, NULL, threadTouch, tasks + thread_index);
+    }
+
+    for (size_t thread_index = 0; thread_index < touch_parts; thread_index++){
+        pthread_join(threads[thread_index], NULL);
+    }
+}
+
+static void * threadTouch(void * task_ptr)
+{
+    assert(task_ptr);
+
+    touch_task_t * task = (touch_task_t *)task_ptr;
+
+    if (! task->len)
+        return NULL;
+
+    bindThreadToCpu(task->thread_index);
+    memset(task->start, 0, task->len);
+
+    return NULL;
+}
+
+static void initPinCpus()
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0){
+        fprintf(stderr, "ERROR: Could not get cpu affinity of the process: %s, threads are not pinned\n", strerror(errno));
+        return;
+    }
+
+    bool is_listed[CPU_SETSIZE] = {};
+
+    for (int node = 0; node < MAX_NUMA_NODES; node++){
+        char path[64] = "";
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+
+        FILE * cpulist_file = fopen(path, "r");
+        if (! cpulist_file)
+            continue;
+
+        addNodeCpus(cpulist_file, &allowed, is_listed);
+        fclose(cpulist_file);
+    }
+
+    // cpus the kernel gives no node information for
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++){
+        if (CPU_ISSET(cpu, &allowed) && ! is_listed[cpu])
+            pin_cpus[pin_cpus_num++] = cpu;
+    }
+}
+
+/// @brief appends allowed cpus from cpulist of a node (ranges like "0-3,8-11") to pin_cpus
+static void addNodeCpus(FILE * cpulist_file, const cpu_set_t * allowed, bool * is_listed)
+{
+    assert(cpulist_file);
+    assert(allowed);
+    assert(is_listed);
+
+    int first_cpu = 0;
+
+    while (fscanf(cpulist_file, "%d", &first_cpu) == 1){
+        int last_cpu = first_cpu;
+        int separator = fgetc(cpulist_file);
+
+        if (separator == '-'){
+            if (fscanf(cpulist_file, "%d", &last_cpu) != 1)
+                return;
+
+            separator = fgetc(cpulist_file);
+        }
+
+        for (int cpu = first_cpu; cpu <= last_cpu && cpu < CPU_SETSIZE; cpu++){
+            if (cpu < 0 || ! CPU_ISSET(cpu, allowed) || is_listed[cpu])
+                continue;
+
+            is_listed[cpu] = true;
+            pin_cpus[pin_cpus_num++] = cpu;
+        }
+
+        if (separator != ',')
+            return;
+    }
+}
@@ -0,0 +1,541 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <assert.h>
+
+#include "iter_file.h"
+#include "mandelbrot.h"
+#include "frame_alloc.h"
+
+struct iter_writer {
+    FILE * file;
+    iter_file_header_t header;
+
+    iter_tile_entry_t * index;
+    uint64_t offset;
+
+    // rows of the current row of tiles
+    uint32_t * band;
+    uint32_t band_rows;
+    uint32_t next_tile_y;
+
+    uint8_t * encoded;
+
+    bool is_failed;
+};
+
+struct iter_file {
+    const uint8_t * data;
+    size_t size;
+
+    const iter_file_header_t * header;
+    const iter_tile_entry_t  * index;
+};
+
+typedef struct {
+    const iter_file_t * file;
+
+    // region of the frame
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+    uint32_t * nums;
+
+    // rows of tiles decoded by this thread
+    uint32_t tile_y_begin;
+    uint32_t tile_y_end;
+
+    bool is_threaded;       // false - thread was not created, rows are decoded by the calling thread
+    bool is_ok;
+} decode_task_t;
+
+static size_t maxEncodedTileSize(const uint32_t tile_size);
+
+static bool writeBand(iter_writer_t * writer);
+
+static size_t encodeTile(const uint32_t * nums, const size_t stride, const uint32_t tile_width, const uint32_t tile_height, uint8_t * encoded);
+
+static bool decodeTile(const uint8_t * encoded, const size_t size, const uint32_t tile_width, const uint32_t tile_height, uint32_t * nums);
+
+static void * decodeTilesThread(void * task_ptr);
+
+static inline uint32_t zigzagEncode(const uint32_t num, const uint32_t pred)
+{
+    const int32_t delta = (int32_t)(num - pred);
+
+    return ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+}
+
+static inline uint32_t zigzagDecode(const uint32_t code, const uint32_t pred)
+{
+    return pred + ((code >> 1) ^ (0u - (code & 1)));
+}
+
+
+iter_writer_t * iterWriterCtor(const char * file_name, const mandelbrot_context_t * md)
+{
+    assert(file_name);
+    assert(md);
+
+    iter_writer_t * writer = (iter_writer_t *)calloc(1, sizeof(*writer));
+    if (! writer){
+        fprintf(stderr, "ERROR: Could not allocate memory for iteration file writer\n");
+        return NULL;
+    }
+
+    iter_file_header_t * header = &writer->header;
+
+    header->magic     = ITER_FILE_MAGIC;
+    header->version   = ITER_FILE_VERSION;
+    header->center_x  = md->center_x;
+    header->center_y  = md->center_y;
+    header->scale     = md->scale;
+    header->iter_num  = md->iter_num;
+    header->width     = md->sc_width;
+    header->height    = md->sc_height;
+    header->tile_size = ITER_TILE_SIZE;
+    header->tiles_x   = (uint32_t)(((uint64_t)md->sc_width  + ITER_TILE_SIZE - 1) / ITER_TILE_SIZE);
+    header->tiles_y   = (uint32_t)(((uint64_t)md->sc_height + ITER_TILE_SIZE - 1) / ITER_TILE_SIZE);
+
+    writer->file    = fopen(file_name, "wb");
+    writer->index   = (iter_tile_entry_t *)calloc((size_t)header->tiles_x * header->tiles_y + 1, sizeof(iter_tile_entry_t));
+    writer->band    = (uint32_t *)frameAlloc((size_t)ITER_TILE_SIZE * md->sc_width * sizeof(uint32_t), 1);
+    writer->encoded = (uint8_t  *)frameAlloc(maxEncodedTileSize(ITER_TILE_SIZE), 1);
+
+    if (! writer->file || ! writer->index || ! writer->band || ! writer->encoded){
+        fprintf(stderr, "ERROR: Could not create iteration file '%s'\n", file_name);
+
+        writer->is_failed = true;
+        iterWriterDtor(writer);
+        return NULL;
+    }
+
+    // the header is written again with the index offset in the end
+    writer->offset = sizeof(*header);
+    writer->is_failed = fwrite(header, sizeof(*header), 1, writer->file) != 1;
+
+    return writer;
+}
+
+bool iterWriterAddRows(iter_writer_t * writer, const uint32_t * nums, const uint32_t rows_num)
+{
+    assert(writer);
+    assert(nums);
+
+    const uint32_t width = writer->header.width;
+
+    for (uint32_t row_index = 0; row_index < rows_num && ! writer->is_failed; row_index++){
+        if (writer->next_tile_y * ITER_TILE_SIZE + writer->band_rows == writer->header.height){
+            fprintf(stderr, "ERROR: Too many rows are written to iteration file\n");
+            writer->is_failed = true;
+            break;
+        }
+
+        memcpy(writer->band + (size_t)writer->band_rows * width, nums + (size_t)row_index * width, width * sizeof(uint32_t));
+        writer->band_rows++;
+
+        if (writer->band_rows == ITER_TILE_SIZE)
+            writer->is_failed = ! writeBand(writer);
+    }
+
+    return ! writer->is_failed;
+}
+
+bool iterWriterDtor(iter_writer_t * writer)
+{
+    assert(writer);
+
+    if (writer->file && ! writer->is_failed){
+        if (writer->band_rows > 0)
+            writer->is_failed = ! writeBand(writer);
+
+        if (writer->next_tile_y != writer->header.tiles_y){
+            fprintf(stderr, "ERROR: Iteration file is closed before all rows are written\n");
+            writer->is_failed = true;
+        }
+    }
+
+    if (writer->file && ! writer->is_failed){
+        const size_t tiles_num = (size_t)writer->header.tiles_x * writer->header.tiles_y;
+
+        // index is read in place from the mapped file, so it is aligned
+        const uint8_t padding[alignof(iter_tile_entry_t)] = {};
+        const size_t padding_len = (alignof(iter_tile_entry_t) - writer->offset % alignof(iter_tile_entry_t)) % alignof(iter_tile_entry_t);
+
+        writer->header.index_offset = writer->offset + padding_len;
+
+        writer->is_failed = fwrite(padding, 1, padding_len, writer->file) != padding_len
+                         || fwrite(writer->index, sizeof(iter_tile_entry_t), tiles_num, writer->file) != tiles_num
+                         || fseek(writer->file, 0, SEEK_SET) != 0
+                         || fwrite(&writer->header, sizeof(writer->header), 1, writer->file) != 1;
+    }
+
+    if (writer->file && fclose(writer->file) != 0)
+        writer->is_failed = true;
+
+    if (writer->is_failed)
+        fprintf(stderr, "ERROR: Iteration file is not written\n");
+
+    const bool is_written = ! writer->is_failed;
+
+    free(writer->index);
+    frameFree(writer->band);
+    frameFree(writer->encoded);
+    free(writer);
+
+    return is_written;
+}
+
+bool saveIterFile(const char * file_name, const mandelbrot_context_t * md)
+{
+    assert(file_name);
+    assert(md);
+
+    iter_writer_t * writer = iterWriterCtor(file_name, md);
+    if (! writer)
+        return false;
+
+    iterWriterAddRows(writer, md->num_pixels, md->sc_height);
+
+    return iterWriterDtor(writer);
+}
+
+iter_file_t * iterFileOpen(const char * file_name)
+{
+    assert(file_name);
+
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0){
+        fprintf(stderr, "ERROR: Could not open iteration file '%s'\n", file_name);
+        return NULL;
+    }
+
+    struct stat file_stat = {};
+    if (fstat(fd, &file_stat) != 0){
+        fprintf(stderr, "ERROR: Could not get size of iteration file '%s'\n", file_name);
+        close(fd);
+        return NULL;
+    }
+
+    const size_t size = file_stat.st_size;
+
+    void * data = (size >= sizeof(iter_file_header_t)) ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+
+    if (data == MAP_FAILED){
+        fprintf(stderr, "ERROR: Could not map iteration file '%s'\n", file_name);
+        return NULL;
+    }
+
+    // only visible tiles are read, so readahead of the whole file is useless
+    madvise(data, size, MADV_RANDOM);
+
+    const iter_file_header_t * header = (const iter_file_header_t *)data;
+    const size_t tiles_num = (size_t)header->tiles_x * header->tiles_y;
+
+    bool is_correct = header->magic == ITER_FILE_MAGIC && header->version == ITER_FILE_VERSION
+                   && header->tile_size > 0 && header->tile_size <= MAX_ITER_TILE_SIZE
+                   && header->tiles_x == ((uint64_t)header->width  + header->tile_size - 1) / header->tile_size
+                   && header->tiles_y == ((uint64_t)header->height + header->tile_size - 1) / header->tile_size
+                   && header->index_offset >= sizeof(*header) && header->index_offset <= size
+                   && header->index_offset % alignof(iter_tile_entry_t) == 0
+                   && (size - header->index_offset) / sizeof(iter_tile_entry_t) >= tiles_num;
+
+    const iter_tile_entry_t * index = (const iter_tile_entry_t *)((const uint8_t *)data + header->index_offset);
+
+    for (size_t tile_index = 0; is_correct && tile_index < tiles_num; tile_index++){
+        is_correct = index[tile_index].offset >= sizeof(*header) && index[tile_index].offset <= header->index_offset
+                  && index[tile_index].size <= header->index_offset - index[tile_index].offset;
+    }
+
+    if (! is_correct){
+        fprintf(stderr, "ERROR: '%s' is not an iteration file or it is damaged\n", file_name);
+        munmap(data, size);
+        return NULL;
+    }
+
+    iter_file_t * file = (iter_file_t *)calloc(1, sizeof(*file));
+    if (! file){
+        fprintf(stderr, "ERROR: Could not allocate memory for iteration file\n");
+        munmap(data, size);
+        return NULL;
+    }
+
+    file->data   = (const uint8_t *)data;
+    file->size   = size;
+    file->header = header;
+    file->index  = index;
+
+    return file;
+}
+
+const iter_file_header_t * iterFileHeader(const iter_file_t * file)
+{
+    assert(file);
+
+    return file->header;
+}
+
+bool iterFileDecode(const iter_file_t * file, uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                    uint32_t * nums, const size_t threads_num)
+{
+    assert(file);
+    assert(nums);
+    assert(threads_num > 0);
+
+    const iter_file_header_t * header = file->header;
+
+    if ((uint64_t)x + width > header->width || (uint64_t)y + height > header->height){
+        fprintf(stderr, "ERROR: Region %ux%u at (%u, %u) is out of %ux%u frame\n",
+            width, height, x, y, header->width, header->height);
+        return false;
+    }
+
+    if (width == 0 || height == 0)
+        return true;
+
+    const uint32_t tile_y_begin = y / header->tile_size;
+    const uint32_t tile_y_end   = (y + height - 1) / header->tile_size + 1;
+    const uint32_t tile_rows    = tile_y_end - tile_y_begin;
+
+    const size_t tasks_num = (threads_num < tile_rows) ? threads_num : tile_rows;
+
+    pthread_t     * threads = (pthread_t     *)calloc(tasks_num, sizeof(pthread_t));
+    decode_task_t * tasks   = (decode_task_t *)calloc(tasks_num, sizeof(decode_task_t));
+
+    if (! threads || ! tasks){
+        fprintf(stderr, "ERROR: Could not allocate memory for decoding threads\n");
+        free(threads);
+        free(tasks);
+        return false;
+    }
+
+    for (size_t task_index = 0; task_index < tasks_num; task_index++){
+        decode_task_t * task = tasks + task_index;
+
+        task->file   = file;
+        task->x      = x;
+        task->y      = y;
+        task->width  = width;
+        task->height = height;
+        task->nums   = nums;
+
+        task->tile_y_begin = tile_y_begin + tile_rows *  task_index      / tasks_num;
+        task->tile_y_end   = tile_y_begin + tile_rows * (task_index + 1) / tasks_num;
+
+        task->is_threaded = pthread_create(threads + task_index, NULL, decodeTilesThread, task) == 0;
+    }
+
+    bool is_ok = true;
+
+    for (size_t task_index = 0; task_index < tasks_num; task_index++){
+        // rows of a thread which could not be started are decoded here
+        if (tasks[task_index].is_threaded)
+            pthread_join(threads[task_index], NULL);
+        else
+            decodeTilesThread(tasks + task_index);
+
+        is_ok = is_ok && tasks[task_index].is_ok;
+    }
+
+    free(threads);
+    free(tasks);
+
+    if (! is_ok)
+        fprintf(stderr, "ERROR: Iteration file is damaged\n");
+
+    return is_ok;
+}
+
+void iterFileClose(iter_file_t * file)
+{
+    assert(file);
+
+    munmap((void *)file->data, file->size);
+    free(file);
+}
+
+static size_t maxEncodedTileSize(const uint32_t tile_size)
+{
+    // width byte and 32 bit codes in every row
+    return (size_t)tile_size * (1 + tile_size * sizeof(uint32_t));
+}
+
+/// @brief encodes and writes all tiles of the band (last band can have less rows)
+static bool writeBand(iter_writer_t * writer)
+{
+    assert(writer);
+
+    const iter_file_header_t * header = &writer->header;
+
+    for (uint32_t tile_x = 0; tile_x < header->tiles_x; tile_x++){
+        const uint32_t x_begin    = tile_x * ITER_TILE_SIZE;
+        const uint32_t tile_width = (x_begin + ITER_TILE_SIZE < header->width) ? ITER_TILE_SIZE : header->width - x_begin;
+
+        const size_t size = encodeTile(writer->band + x_begin, header->width, tile_width, writer->band_rows, writer->encoded);
+
+        if (fwrite(writer->encoded, 1, size, writer->file) != size)
+            return false;
+
+        iter_tile_entry_t * entry = writer->index + (size_t)writer->next_tile_y * header->tiles_x + tile_x;
+
+        entry->offset = writer->offset;
+        entry->size   = size;
+
+        writer->offset += size;
+    }
+
+    writer->next_tile_y++;
+    writer->band_rows = 0;
+
+    return true;
+}
+
+static size_t encodeTile(const uint32_t * nums, const size_t stride, const uint32_t tile_width, const uint32_t tile_height, uint8_t * encoded)
+{
+    assert(nums);
+    assert(encoded);
+
+    uint32_t codes[ITER_TILE_SIZE] = {};
+    uint8_t * out = encoded;
+
+    for (uint32_t row = 0; row < tile_height; row++){
+        const uint32_t * line = nums + row * stride;
+
+        uint32_t pred = (row > 0) ? line[-(ptrdiff_t)stride] : 0;
+        uint32_t all_codes = 0;
+
+        for (uint32_t col = 0; col < tile_width; col++){
+            codes[col] = zigzagEncode(line[col], pred);
+            all_codes |= codes[col];
+            pred = line[col];
+        }
+
+        const uint32_t bits = (all_codes == 0) ? 0 : 32 - __builtin_clz(all_codes);
+        *out++ = (uint8_t)bits;
+
+        uint64_t acc = 0;
+        uint32_t acc_bits = 0;
+
+        for (uint32_t col = 0; col < tile_width && bits > 0; col++){
+            acc |= (uint64_t)codes[col] << acc_bits;
+            acc_bits += bits;
+
+            while (acc_bits >= 8){
+                *out++ = (uint8_t)acc;
+                acc >>= 8;
+                acc_bits -= 8;
+            }
+        }
+
+        if (acc_bits > 0)
+            *out++ = (uint8_t)acc;
+    }
+
+    return out - encoded;
+}
+
+static bool decodeTile(const uint8_t * encoded, const size_t size, const uint32_t tile_width, const uint32_t tile_height, uint32_t * nums)
+{
+    assert(encoded);
+    assert(nums);
+
+    const uint8_t * in     = encoded;
+    const uint8_t * in_end = encoded + size;
+
+    for (uint32_t row = 0; row < tile_height; row++){
+        uint32_t * line = nums + row * tile_width;
+
+        if (in == in_end)
+            return false;
+
+        const uint32_t bits = *in++;
+        const size_t row_size = ((size_t)tile_width * bits + 7) / 8;
+
+        if (bits > 32 || row_size > (size_t)(in_end - in))
+            return false;
+
+        uint32_t pred = (row > 0) ? line[-(ptrdiff_t)tile_width] : 0;
+
+        // rows of the set and of one escape number are the most frequent ones
+        if (bits == 0){
+            for (uint32_t col = 0; col < tile_width; col++)
+                line[col] = pred;
+
+            continue;
+        }
+
+        const uint64_t mask = (1ull << bits) - 1;
+
+        uint64_t acc = 0;
+        uint32_t acc_bits = 0;
+
+        for (uint32_t col = 0; col < tile_width; col++){
+            while (acc_bits < bits){
+                acc |= (uint64_t)(*in++) << acc_bits;
+                acc_bits += 8;
+            }
+
+            pred = zigzagDecode((uint32_t)(acc & mask), pred);
+            line[col] = pred;
+
+            acc >>= bits;
+            acc_bits -= bits;
+        }
+    }
+
+    return in == in_end;
+}
+
+static void * decodeTilesThread(void * task_ptr)
+{
+    assert(task_ptr);
+
+    decode_task_t * task = (decode_task_t *)task_ptr;
+    const iter_file_header_t * header = task->file->header;
+    const uint32_t tile_size = header->tile_size;
+
+    uint32_t * tile_nums = (uint32_t *)frameAlloc((size_t)tile_size * tile_size * sizeof(uint32_t), 1);
+
+    const uint32_t tile_x_begin = task->x / tile_size;
+    const uint32_t tile_x_end   = (task->x + task->width - 1) / tile_size + 1;
+
+    task->is_ok = tile_nums != NULL;
+
+    for (uint32_t tile_y = task->tile_y_begin; tile_y < task->tile_y_end && task->is_ok; tile_y++){
+        for (uint32_t tile_x = tile_x_begin; tile_x < tile_x_end && task->is_ok; tile_x++){
+            const uint32_t x_begin = tile_x * tile_size;
+            const uint32_t y_begin = tile_y * tile_size;
+
+            const uint32_t tile_width  = ((uint64_t)x_begin + tile_size < header->width ) ? tile_size : header->width  - x_begin;
+            const uint32_t tile_height = ((uint64_t)y_begin + tile_size < header->height) ? tile_size : header->height - y_begin;
+
+            const iter_tile_entry_t * entry = task->file->index + (size_t)tile_y * header->tiles_x + tile_x;
+
+            task->is_ok = decodeTile(task->file->data + entry->offset, entry->size, tile_width, tile_height, tile_nums);
+
+            // intersection of the tile and the region
+            const uint32_t copy_x_begin = (x_begin > task->x) ? x_begin : task->x;
+            const uint32_t copy_y_begin = (y_begin > task->y) ? y_begin : task->y;
+            const uint32_t copy_x_end   = ((uint64_t)x_begin + tile_width  < (uint64_t)task->x + task->width ) ? x_begin + tile_width  : task->x + task->width;
+            const uint32_t copy_y_end   = ((uint64_t)y_begin + tile_height < (uint64_t)task->y + task->height) ? y_begin + tile_height : task->y + task->height;
+
+            for (uint32_t copy_y = copy_y_begin; copy_y < copy_y_end && task->is_ok; copy_y++){
+                memcpy(task->nums + (size_t)(copy_y - task->y) * task->width + (copy_x_begin - task->x),
+                       tile_nums + (size_t)(copy_y - y_begin) * tile_width + (copy_x_begin - x_begin),
+                       (copy_x_end - copy_x_begin) * sizeof(uint32_t));
+            }
+        }
+    }
+
+    frameFree(tile_nums);
+
+    return NULL;
+}
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <assert.h>
+
+#include "iter_probe.h"
+#include "mandelbrot.h"
+#include "frame_alloc.h"
+
+static size_t countEscapedBetween(const uint32_t * nums, const size_t nums_len, const uint32_t min_num, const uint32_t iter_num);
+
+static size_t packNotEscaped(float * x0, float * y0, const uint32_t * nums, const size_t nums_len, const uint32_t iter_num);
+
+
+iter_probe_result_t probeIterNum(const mandelbrot_context_t * md)
+{
+    assert(md);
+
+    iter_probe_result_t result = {};
+    result.iter_num = md->iter_num;
+
+    struct timespec probe_start = {};
+    struct timespec probe_end   = {};
+    clock_gettime(CLOCK_MONOTONIC, &probe_start);
+
+    const uint32_t probe_width  = md->sc_width  / PROBE_DIVIDER;
+    const uint32_t probe_height = md->sc_height / PROBE_DIVIDER;
+    const size_t   probe_len    = probe_width * probe_height;
+
+    float    * x0   = (float    *)frameAlloc(probe_len * sizeof(*x0),   1);
+    float    * y0   = (float    *)frameAlloc(probe_len * sizeof(*y0),   1);
+    uint32_t * nums = (uint32_t *)frameAlloc(probe_len * sizeof(*nums), 1);
+
+    if (! x0 || ! y0 || ! nums){
+        fprintf(stderr, "ERROR: Could not allocate memory for iteration probe\n");
+        frameFree(x0); frameFree(y0); frameFree(nums);
+        return result;
+    }
+
+    const float left_x   = md->center_x - md->sc_width  * md->scale / 2;
+    const float bottom_y = md->center_y - md->sc_height * md->scale / 2;
+
+    // every probe pixel is the center of PROBE_DIVIDER x PROBE_DIVIDER block of screen pixels,
+    // pixels which never escape do not change the limit, so known ones are not calculated at all
+    size_t calc_len = 0;
+
+    for (uint32_t iy = 0; iy < probe_height; iy++){
+        for (uint32_t ix = 0; ix < probe_width; ix++){
+            float x = left_x   + (ix * PROBE_DIVIDER + PROBE_DIVIDER / 2) * md->scale;
+            float y = bottom_y + (iy * PROBE_DIVIDER + PROBE_DIVIDER / 2) * md->scale;
+
+            if (isInMainBulbs(x, y))
+                continue;
+
+            x0[calc_len] = x;
+            y0[calc_len] = y;
+            calc_len++;
+        }
+    }
+
+    uint32_t iter_num = md->iter_num;
+
+    calcMandelbrotPoints(x0, y0, nums, calc_len, iter_num);
+    result.probe_calcs += calc_len;
+
+    bool is_lowered = false;
+
+    // lowering: (almost) nothing escapes in the upper half of the limit
+    while (iter_num / 2 >= PROBE_MIN_ITER_NUM && countEscapedBetween(nums, calc_len, iter_num / 2, iter_num) <= PROBE_LOWER_SHARE * probe_len){
+        iter_num /= 2;
+        is_lowered = true;
+
+        for (size_t index = 0; index < calc_len; index++){
+            if (nums[index] > iter_num)
+                nums[index] = iter_num;
+        }
+    }
+
+    // raising: only pixels that reached the limit are recalculated with the doubled one
+    size_t not_escaped_len = calc_len;
+
+    while (! is_lowered && 2 * iter_num <= PROBE_MAX_ITER_NUM){
+        not_escaped_len = packNotEscaped(x0, y0, nums, not_escaped_len, iter_num);
+
+        calcMandelbrotPoints(x0, y0, nums, not_escaped_len, 2 * iter_num);
+        result.probe_calcs += not_escaped_len;
+
+        if (countEscapedBetween(nums, not_escaped_len, iter_num, 2 * iter_num) <= PROBE_RAISE_SHARE * probe_len)
+            break;
+
+        iter_num *= 2;
+    }
+
+    frameFree(x0);
+    frameFree(y0);
+    frameFree(nums);
+
+    clock_gettime(CLOCK_MONOTONIC, &probe_end);
+
+    result.iter_num     = iter_num;
+    result.probe_pixels = probe_len;
+    result.time = 1000 * (probe_end.tv_sec - probe_start.tv_sec) + (probe_end.tv_nsec - probe_start.tv_nsec) / 1e6;
+
+    return result;
+}
+
+/// @brief number of pixels escaped on iteration in [min_num, iter_num)
+static size_t countEscapedBetween(const uint32_t * nums, const size_t nums_len, const uint32_t min_num, const uint32_t iter_num)
+{
+    assert(nums);
+
+    size_t escaped_num = 0;
+
+    for (size_t index = 0; index < nums_len; index++){
+        if (nums[index] >= min_num && nums[index] < iter_num)
+            escaped_num++;
+    }
+
+    return escaped_num;
+}
+
+/// @brief moves pixels which have not escaped to the beginning of the arrays, returns their number
+static size_t packNotEscaped(float * x0, float * y0, const uint32_t * nums, const size_t nums_len, const uint32_t iter_num)
+{
+    assert(x0);
+    assert(y0);
+    assert(nums);
+
+    size_t packed_len = 0;
+
+    for (size_t index = 0; index < nums_len; index++){
+        if (nums[index] == iter_num){
+            x0[packed_len] = x0[index];
+            y0[packed_len] = y0[index];
+            packed_len++;
+        }
+    }
+
+    return packed_len;
+}
@@ -7,30 +7,141 @@
 #include "mandelbrot.h"
 #include "window_handler.h"
 #include "test_mandelbrot.h"
+#include "buddhabrot.h"
+#include "distributed.h"
+#include "frame_alloc.h"
 
 const uint32_t SC_WIDTH  = 1284;
 const uint32_t SC_HEIGHT = 720;
 
+const size_t DISTRIBUTED_FRAMES_NUM = 5;
+
+const char * const GOLDEN_DIR = "golden";
+
 int main(int argc, char ** argv)
 {
+    setThreadPinning(true);
+
     if (argc > 1 && strcmp(argv[1], "-t") == 0){
-        if (argc != 3){
-            fprintf(stderr, "ERROR: -t num of cycles expected\n");
+        if (argc != 3 && argc != 5){
+            fprintf(stderr, "ERROR: -t num of cycles [width height] expected\n");
             return 1;
         }
 
         size_t measure_time = atoi(argv[2]);
 
-        mandelbrot_context_t md = mandelbrotCtor(SC_WIDTH, SC_HEIGHT);
+        // aligned and streaming stores are used only for widths divisible by the pack
+        const uint32_t width  = (argc == 5) ? atoi(argv[3]) : SC_WIDTH;
+        const uint32_t height = (argc == 5) ? atoi(argv[4]) : SC_HEIGHT;
+
+        if (width == 0 || height == 0){
+            fprintf(stderr, "ERROR: -t frame size should not be zero\n");
+            return 1;
+        }
+
+        mandelbrot_context_t md = mandelbrotCtor(width, height);
 
         printOptionsInfo(&md);
 
-        printf("--------TESTING (%u x %u)--------\n", SC_WIDTH, SC_HEIGHT);
+        printf("--------TESTING (%u x %u)--------\n", width, height);
         testMandelbrot(&md, measure_time);
 
         return 0;
     }
 
+    if (argc > 1 && strcmp(argv[1], "-b") == 0){
+        if (argc != 3){
+            fprintf(stderr, "ERROR: -b num of samples expected\n");
+            return 1;
+        }
+
+        size_t samples_num = atol(argv[2]);
+
+        mandelbrot_context_t md = mandelbrotCtor(SC_WIDTH, SC_HEIGHT);
+
+        printOptionsInfo(&md);
+
+        printf("--------BUDDHABROT (%u x %u)--------\n", SC_WIDTH, SC_HEIGHT);
+        testBuddhabrot(&md, samples_num);
+
+        mandelbrotDtor(&md);
+        return 0;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "-w") == 0){
+        if (argc != 4){
+            fprintf(stderr, "ERROR: -w coordinator host and port expected\n");
+            return 1;
+        }
+
+        return runWorker(argv[2], (uint16_t)atoi(argv[3]));
+    }
+
+    if (argc > 1 && strcmp(argv[1], "-d") == 0){
+        if (argc < 3 || argc > 6){
+            fprintf(stderr, "ERROR: -d num of local workers [port [num of workers to wait for [bind address]]] expected\n");
+            return 1;
+        }
+
+        coordinator_params_t params = {};
+        params.local_workers_num = atoi(argv[2]);
+        params.port              = (argc > 3) ? (uint16_t)atoi(argv[3]) : 0;
+        params.min_workers_num   = (argc > 4) ? atoi(argv[4]) : params.local_workers_num;
+        params.bind_address      = (argc > 5) ? argv[5] : NULL;
+
+        if (params.local_workers_num > MAX_WORKERS_NUM || params.min_workers_num > MAX_WORKERS_NUM){
+            fprintf(stderr, "ERROR: no more than %zu workers are supported\n", MAX_WORKERS_NUM);
+            return 1;
+        }
+
+        mandelbrot_context_t md = mandelbrotCtor(SC_WIDTH, SC_HEIGHT);
+
+        printOptionsInfo(&md);
+
+        printf("--------DISTRIBUTED (%u x %u)--------\n", SC_WIDTH, SC_HEIGHT);
+        testDistributed(&md, &params, DISTRIBUTED_FRAMES_NUM);
+
+        mandelbrotDtor(&md);
+        return 0;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "-s") == 0){
+        if (argc != 5){
+            fprintf(stderr, "ERROR: -s file name, width and height expected\n");
+            return 1;
+        }
+
+        printf("--------ITERATION FILE SAVING--------\n");
+        testIterFileSave(argv[2], atoi(argv[3]), atoi(argv[4]));
+
+        return 0;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "-r") == 0){
+        if (argc != 3 && argc != 7){
+            fprintf(stderr, "ERROR: -r file name [x y width height] expected\n");
+            return 1;
+        }
+
+        printf("--------RECOLORING--------\n");
+
+        if (argc == 7)
+            testIterFileRecolor(argv[2], atoi(argv[3]), atoi(argv[4]), atoi(argv[5]), atoi(argv[6]));
+        else
+            testIterFileRecolor(argv[2], 0, 0, 0, 0);
+
+        return 0;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "-g") == 0){
+        const bool is_update = argc > 2 && strcmp(argv[argc - 1], "-u") == 0;
+        const char * golden_dir = (argc > 2 && strcmp(argv[2], "-u") != 0) ? argv[2] : GOLDEN_DIR;
+
+        printf("--------GOLDEN FRAMES TEST--------\n");
+
+        return testGolden(golden_dir, is_update) ? 0 : 1;
+    }
+
     runWindow(SC_WIDTH, SC_HEIGHT);
 
     return 0;
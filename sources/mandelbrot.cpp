@@ -6,81 +6,51 @@
 #include <string.h>
 #include <assert.h>
 
-#include <xmmintrin.h>
-#include <immintrin.h>
-
 #include "mandelbrot.h"
+#include "simd.h"
+#include "frame_alloc.h"
 
-#ifdef AVX_ON
-    typedef __m256 mXXX;
-    typedef __m256i mXXXi;
-
-    // size of ymm register in bytes
-    #define PACK_SIZE 32
-    #define NUMS_IN_PACK (PACK_SIZE / sizeof(float))
-
-    #define mm_set_ps           _mm256_set_ps
-    #define mm_set1_ps          _mm256_set1_ps
-
-    #define mm_castsiXXX_ps     _mm256_castsi256_ps
-    #define mm_castps_siXXX     _mm256_castps_si256
-
-    #define mm_add_ps           _mm256_add_ps
-    #define mm_mul_ps           _mm256_mul_ps
-    #define mm_sub_ps           _mm256_sub_ps
-    #define mm_and_ps           _mm256_and_ps
-
-    #define mm_cmple_ps(a, b)   _mm256_cmp_ps((a), (b), _CMP_LE_OS)
-
-    #define mm_movemask_ps      _mm256_movemask_ps
-    #define mm_movemask_ps      _mm256_movemask_ps
+// file is built twice: for the native backend and with -DSIMD_GENERIC -DSIMD_NAMESPACE=simd_generic,
+// then all its functions are in that namespace, so the benchmark compares both backends in one run
+#ifdef SIMD_NAMESPACE
+namespace SIMD_NAMESPACE {
+#endif
 
-    #define mm_set1_epi32       _mm256_set1_epi32
-    #define mm_add_epi32        _mm256_add_epi32
-    #define mm_storeu_siXXX     _mm256_storeu_si256
-    #define mm_and_siXXX        _mm256_and_si256
+// frame buffers are allocated by frameAlloc, so rows are aligned for packs only if screen width is divisible by pack
+// (NUMS_IN_PACK), other widths (like the default 1284) are stored by unaligned stores and STREAM_STORES do nothing for them
+#ifdef STREAM_STORES
+    #define mm_store_frame      mm_stream_siXXX
+    #define STORE_FENCE()       mm_sfence()
 #else
-    typedef __m128  mXXX;
-    typedef __m128i mXXXi;
-
-    // size of xmm register in bytes
-    #define PACK_SIZE 16
-    #define NUMS_IN_PACK (PACK_SIZE / sizeof(float))
-
-    #define mm_set_ps           _mm_set_ps
-    #define mm_set1_ps          _mm_set1_ps
-
-    #define mm_castsiXXX_ps     _mm_castsi128_ps
-    #define mm_castps_siXXX     _mm_castps_si128
-
-    #define mm_add_ps           _mm_add_ps
-    #define mm_mul_ps           _mm_mul_ps
-    #define mm_sub_ps           _mm_sub_ps
-    #define mm_and_ps           _mm_and_ps
+    #define mm_store_frame      mm_store_siXXX
+    #define STORE_FENCE()
+#endif
 
-    #define mm_cmple_ps         _mm_cmple_ps
-    #define mm_movemask_ps      _mm_movemask_ps
-    #define mm_movemask_ps      _mm_movemask_ps
+#define IS_FRAME_ALIGNED(md)                                                            \
+    ((uintptr_t)((md)->num_pixels) % PACK_SIZE == 0 && (md)->sc_width % NUMS_IN_PACK == 0)
 
-    #define mm_set1_epi32       _mm_set1_epi32
-    #define mm_add_epi32        _mm_add_epi32
-    #define mm_storeu_siXXX     _mm_storeu_si128
-    #define mm_and_siXXX        _mm_and_si128
-#endif
+#define STORE_NUMS(addr, n, is_aligned)                                                 \
+do {                                                                                    \
+    if (is_aligned)                                                                     \
+        mm_store_frame((addr), (n));                                                    \
+    else                                                                                \
+        mm_storeu_siXXX((addr), (n));                                                   \
+} while(0)
 
 const float MAX_R2   = 100.;
 
-static void calculateColorTable(const mandelbrot_context_t * md);
 
 
 mandelbrot_context_t mandelbrotCtor(const uint32_t width, const uint32_t height)
 {
     mandelbrot_context_t md = {};
 
-    md.num_pixels   = (uint32_t *)calloc(width * height, sizeof(*(md.num_pixels)));
-    md.color_pixels = (uint32_t *)calloc(width * height, sizeof(*(md.color_pixels)));
+    md.num_pixels   = (uint32_t *)frameAlloc(((size_t)width * height + FRAME_PADDING_PIXELS) * sizeof(*(md.num_pixels)),   DEFAULT_THREADS_NUM);
+    md.color_pixels = (uint32_t *)frameAlloc(((size_t)width * height + FRAME_PADDING_PIXELS) * sizeof(*(md.color_pixels)), DEFAULT_THREADS_NUM);
 
-    md.color_table  = (uint32_t *)calloc(COLOR_TABLE_LEN, sizeof(*(md.color_table)));
+    md.dist_pixels  = (float    *)frameAlloc(((size_t)width * height + FRAME_PADDING_PIXELS) * sizeof(*(md.dist_pixels)),  DEFAULT_THREADS_NUM);
+
+    md.color_table  = (uint32_t *)frameAlloc(COLOR_TABLE_LEN * sizeof(*(md.color_table)), 1);
     calculateColorTable(&md);
 
     md.scale = DEFAULT_PLOT_WIDTH / width;
@@ -100,8 +70,30 @@ void mandelbrotDtor(mandelbrot_context_t * md)
 {
     assert(md);
 
-    free(md->num_pixels);
-    free(md->color_pixels);
+    frameFree(md->num_pixels);
+    frameFree(md->color_pixels);
+    frameFree(md->dist_pixels);
+    frameFree(md->color_table);
+}
+
+void mandelbrotResize(mandelbrot_context_t * md, const uint32_t width, const uint32_t height)
+{
+    assert(md);
+
+    // plot width is kept
+    md->scale = md->scale * md->sc_width / width;
+
+    // buffers are given back to the arena first, so the same ones are taken if they are big enough
+    frameFree(md->num_pixels);
+    frameFree(md->color_pixels);
+    frameFree(md->dist_pixels);
+
+    md->num_pixels   = (uint32_t *)frameAlloc(((size_t)width * height + FRAME_PADDING_PIXELS) * sizeof(*(md->num_pixels)),   DEFAULT_THREADS_NUM);
+    md->color_pixels = (uint32_t *)frameAlloc(((size_t)width * height + FRAME_PADDING_PIXELS) * sizeof(*(md->color_pixels)), DEFAULT_THREADS_NUM);
+    md->dist_pixels  = (float    *)frameAlloc(((size_t)width * height + FRAME_PADDING_PIXELS) * sizeof(*(md->dist_pixels)),  DEFAULT_THREADS_NUM);
+
+    md->sc_width  = width;
+    md->sc_height = height;
 }
 
 // p_n = p_{n-1}^2 + p0
@@ -113,6 +105,8 @@ void calcMandelbrot(mandelbrot_context_t * md)
 {
     assert(md);
 
+    const bool is_aligned = IS_FRAME_ALIGNED(md);
+
     const uint32_t sc_width  = md->sc_width;
     const uint32_t sc_height = md->sc_height;
     const uint32_t iter_num  = md->iter_num;
@@ -125,12 +119,7 @@ void calcMandelbrot(mandelbrot_context_t * md)
     const float dx = (right_x - left_x) / md->sc_width;
     const float dy = dx;
 
-    // reversed for easy storing in the memory
-    #ifdef AVX_ON
-    const __m256 delta = _mm256_set_ps(dx*7, dx*6, dx*5, dx*4, dx*3, dx*2, dx, 0);
-    #else
-    const __m128 delta = _mm_set_ps(dx*3, dx*2, dx, 0);
-    #endif
+    const mXXX delta = mm_delta_ps(dx);
 
     const mXXX max_r2_packed = mm_set1_ps(MAX_R2);
 
@@ -163,7 +152,7 @@ void calcMandelbrot(mandelbrot_context_t * md)
                 mXXX r2 = mm_add_ps(x2, y2);
 
                 mXXX cmp_res = mm_cmple_ps(r2, max_r2_packed);
-                int mask = mm_movemask_ps(cmp_res);
+                int mask = mm_any_ps(cmp_res);
 
                 if (!mask)
                     break;
@@ -182,10 +171,11 @@ void calcMandelbrot(mandelbrot_context_t * md)
 
                 y = mm_add_ps(_2xy, y0);
             }
-            mXXXi * store_addr = (mXXXi *)(md->num_pixels + iy * sc_width + ix);
-            mm_storeu_siXXX(store_addr, n);
+            mXXXi * store_addr = (mXXXi *)(md->num_pixels + (size_t)iy * sc_width + ix);
+            STORE_NUMS(store_addr, n, is_aligned);
         }
     }
+    STORE_FENCE();
 }
 
 #define INTRIN_CYCLE for (size_t i = 0; i < INTRIN_PACK_SIZE; i++)
@@ -194,8 +184,25 @@ void calcMandelbrotConveyor(mandelbrot_context_t * md)
 {
     assert(md);
 
+    calcMandelbrotConveyorRows(md, 0, md->sc_height);
+}
+
+void calcMandelbrotConveyorRows(const mandelbrot_context_t * md, const uint32_t row_begin, const uint32_t row_end)
+{
+    assert(md);
+
+    calcMandelbrotConveyorTile(md, row_begin, row_end, md->num_pixels + (size_t)row_begin * md->sc_width);
+}
+
+void calcMandelbrotConveyorTile(const mandelbrot_context_t * md, const uint32_t row_begin, const uint32_t row_end, uint32_t * tile_pixels)
+{
+    assert(md);
+    assert(tile_pixels);
+    assert(row_begin <= row_end && row_end <= md->sc_height);
+
+    const bool is_aligned = (uintptr_t)tile_pixels % PACK_SIZE == 0 && md->sc_width % NUMS_IN_PACK == 0;
+
     const uint32_t sc_width  = md->sc_width;
-    const uint32_t sc_height = md->sc_height;
     const uint32_t iter_num  = md->iter_num;
 
     const float left_x  = md->center_x - md->sc_width * md->scale / 2;
@@ -206,12 +213,7 @@ void calcMandelbrotConveyor(mandelbrot_context_t * md)
     const float dx = (right_x - left_x) / md->sc_width;
     const float dy = dx;
 
-    // reversed for easy storing in the memory
-    #ifdef AVX_ON
-    const __m256 delta = _mm256_set_ps(dx*7, dx*6, dx*5, dx*4, dx*3, dx*2, dx, 0);
-    #else
-    const __m128 delta = _mm_set_ps(dx*3, dx*2, dx, 0);
-    #endif
+    const mXXX delta = mm_delta_ps(dx);
 
     const mXXX max_r2_packed = mm_set1_ps(MAX_R2);
 
@@ -221,7 +223,7 @@ void calcMandelbrotConveyor(mandelbrot_context_t * md)
     const mXXX abs_mask = mm_castsiXXX_ps(mm_set1_epi32(~(1 << 31)));
     #endif
 
-    for (uint32_t iy = 0; iy < sc_height; iy++){
+    for (uint32_t iy = row_begin; iy < row_end; iy++){
         mXXX y0[INTRIN_PACK_SIZE] = {};
         INTRIN_CYCLE y0[i] = mm_set1_ps(bottom_y + (iy) * dy);
 
@@ -259,7 +261,7 @@ void calcMandelbrotConveyor(mandelbrot_context_t * md)
 
                 int continue_calc = 0;
                 INTRIN_CYCLE {
-                    int mask = mm_movemask_ps(cmp_res[i]);
+                    int mask = mm_any_ps(cmp_res[i]);
                     continue_calc |= mask;
                 }
                 if (! continue_calc)
@@ -283,48 +285,142 @@ void calcMandelbrotConveyor(mandelbrot_context_t * md)
                 INTRIN_CYCLE y[i] = mm_add_ps(_2xy[i], y0[i]);
             }
 
+            // packs beyond the row end are not stored, rows can be calculated by different threads
             INTRIN_CYCLE {
-                mXXXi * store_addr = (mXXXi *)(md->num_pixels + iy * sc_width + ix + i * NUMS_IN_PACK);
-                mm_storeu_siXXX(store_addr, n[i]);
+                const uint32_t pack_x = ix + i * NUMS_IN_PACK;
+                uint32_t * store_addr = tile_pixels + (size_t)(iy - row_begin) * sc_width + pack_x;
+
+                if (pack_x + NUMS_IN_PACK <= sc_width){
+                    STORE_NUMS((mXXXi *)store_addr, n[i], is_aligned);
+                }
+                else if (pack_x < sc_width){
+                    uint32_t n_tail[NUMS_IN_PACK] = {};
+                    mm_storeu_siXXX((mXXXi *)n_tail, n[i]);
+                    memcpy(store_addr, n_tail, (sc_width - pack_x) * sizeof(uint32_t));
+                }
             }
         }
     }
+    STORE_FENCE();
+}
+
+void calcMandelbrotPoints(const float * x0_arr, const float * y0_arr, uint32_t * nums, const size_t points_num, const uint32_t iter_num)
+{
+    assert(x0_arr);
+    assert(y0_arr);
+    assert(nums);
+
+    const mXXX max_r2_packed = mm_set1_ps(MAX_R2);
+
+    const mXXXi mask_for_n = mm_set1_epi32(1);
+
+    #ifdef BURNING_SHIP
+    const mXXX abs_mask = mm_castsiXXX_ps(mm_set1_epi32(~(1 << 31)));
+    #endif
+
+    for (size_t point_index = 0; point_index < points_num; point_index += NUMS_IN_PACK){
+        // tail is copied to the local pack so we never read or write out of bounds
+        float    x0_tail[NUMS_IN_PACK] = {};
+        float    y0_tail[NUMS_IN_PACK] = {};
+        uint32_t n_tail [NUMS_IN_PACK] = {};
+
+        const size_t left_num = points_num - point_index;
+        const bool   is_tail  = left_num < NUMS_IN_PACK;
+
+        if (is_tail){
+            memcpy(x0_tail, x0_arr + point_index, left_num * sizeof(float));
+            memcpy(y0_tail, y0_arr + point_index, left_num * sizeof(float));
+        }
+
+        const mXXX x0 = mm_loadu_ps(is_tail ? x0_tail : x0_arr + point_index);
+        const mXXX y0 = mm_loadu_ps(is_tail ? y0_tail : y0_arr + point_index);
+
+        mXXX x = x0;
+        mXXX y = y0;
+
+        mXXXi n = mm_set1_epi32(0);
+
+        for (uint32_t iteration = 0; iteration < iter_num; iteration++){
+            mXXX x2 = mm_mul_ps(x, x);
+            mXXX y2 = mm_mul_ps(y, y);
+
+            mXXX _2xy = mm_mul_ps(x, y);
+            _2xy = mm_add_ps(_2xy, _2xy);
+
+            mXXX r2 = mm_add_ps(x2, y2);
+
+            mXXX cmp_res = mm_cmple_ps(r2, max_r2_packed);
+
+            if (! mm_any_ps(cmp_res))
+                break;
+
+            mXXXi delta_n = mm_castps_siXXX(cmp_res);
+            delta_n = mm_and_siXXX(delta_n, mask_for_n);
+
+            n = mm_add_epi32(n, delta_n);
+
+            x = mm_add_ps(mm_sub_ps(x2, y2), x0);
+
+            #ifdef BURNING_SHIP
+                _2xy = mm_and_ps(_2xy, abs_mask);
+            #endif
+
+            y = mm_add_ps(_2xy, y0);
+        }
+
+        if (is_tail){
+            mm_storeu_siXXX((mXXXi *)n_tail, n);
+            memcpy(nums + point_index, n_tail, left_num * sizeof(uint32_t));
+        }
+        else
+            mm_storeu_siXXX((mXXXi *)(nums + point_index), n);
+    }
 }
 
-static void * threadCalcMandelbrot(void * md_ptr)
+typedef struct {
+    const mandelbrot_context_t * md;
+    void (*calc_func)(const mandelbrot_context_t * md, const uint32_t row_begin, const uint32_t row_end);
+
+    uint32_t row_begin;
+    uint32_t row_end;
+
+    size_t thread_index;
+} thread_task_t;
+
+static void * threadCalcMandelbrot(void * task_ptr)
 {
-    assert(md_ptr);
+    assert(task_ptr);
 
-    mandelbrot_context_t * md = (mandelbrot_context_t *)md_ptr;
-    calcMandelbrotConveyor(md);
+    thread_task_t * task = (thread_task_t *)task_ptr;
+
+    bindThreadToCpu(task->thread_index);
+    task->calc_func(task->md, task->row_begin, task->row_end);
 
     return NULL;
 }
 
-void calcMandelbrotMultiThread(mandelbrot_context_t * md, size_t threads_num)
+static void runMultiThread(const mandelbrot_context_t * md, size_t threads_num,
+                           void (*calc_func)(const mandelbrot_context_t * md, const uint32_t row_begin, const uint32_t row_end))
 {
     assert(md);
+    assert(calc_func);
 
     const size_t MAX_THREAD_NUM = 32;
+    assert(threads_num > 0 && threads_num <= MAX_THREAD_NUM);
 
-    mandelbrot_context_t thread_md_context[MAX_THREAD_NUM] = {};
+    thread_task_t thread_tasks[MAX_THREAD_NUM] = {};
     pthread_t threads[MAX_THREAD_NUM] = {};
 
-    size_t rows_per_thread = md->sc_height / threads_num;
-    size_t pixels_per_thread = rows_per_thread * md->sc_width;
-
-    double rows_div_2_scale   = rows_per_thread * md->scale / 2;
-    double height_div_2_scale = md->sc_height * md->scale / 2;
-
+    // rows are calculated exactly as in the whole frame, remainder rows are spread over the threads
     for (size_t thread_index = 0; thread_index < threads_num; thread_index++){
-        memcpy(thread_md_context + thread_index, md, sizeof(mandelbrot_context_t));
+        thread_tasks[thread_index].md        = md;
+        thread_tasks[thread_index].row_begin = md->sc_height *  thread_index      / threads_num;
+        thread_tasks[thread_index].row_end   = md->sc_height * (thread_index + 1) / threads_num;
 
-        thread_md_context[thread_index].color_pixels = NULL;
-        thread_md_context[thread_index].sc_height = rows_per_thread;
-        thread_md_context[thread_index].center_y += rows_div_2_scale * (2*thread_index + 1) - height_div_2_scale;
-        thread_md_context[thread_index].num_pixels += pixels_per_thread * thread_index;
+        thread_tasks[thread_index].calc_func    = calc_func;
+        thread_tasks[thread_index].thread_index = thread_index;
 
-        pthread_create(threads + thread_index, NULL, threadCalcMandelbrot, thread_md_context + thread_index);
+        pthread_create(threads + thread_index, NULL, threadCalcMandelbrot, thread_tasks + thread_index);
     }
 
     for (size_t thread_index = 0; thread_index < threads_num; thread_index++){
@@ -332,6 +428,169 @@ void calcMandelbrotMultiThread(mandelbrot_context_t * md, size_t threads_num)
     }
 }
 
+void calcMandelbrotMultiThread(mandelbrot_context_t * md, size_t threads_num)
+{
+    assert(md);
+
+    runMultiThread(md, threads_num, calcMandelbrotConveyorRows);
+}
+
+// derivative of p_n by p0 (for distance estimation):
+// dp_n = 2 * p_{n-1} * dp_{n-1} + 1
+// dx_new = 2 * (x*dx - y*dy) + 1
+// dy_new = 2 * (x*dy + y*dx)
+// distance to the set ~ |p_n| * ln|p_n| / |dp_n|
+
+void calcMandelbrotDistance(mandelbrot_context_t * md)
+{
+    assert(md);
+
+    calcMandelbrotDistanceRows(md, 0, md->sc_height);
+}
+
+void calcMandelbrotDistanceRows(const mandelbrot_context_t * md, const uint32_t row_begin, const uint32_t row_end)
+{
+    assert(md);
+    assert(md->dist_pixels);
+    assert(row_begin <= row_end && row_end <= md->sc_height);
+
+    const bool is_aligned = IS_FRAME_ALIGNED(md);
+
+    const uint32_t sc_width  = md->sc_width;
+    const uint32_t iter_num  = md->iter_num;
+
+    const float left_x  = md->center_x - md->sc_width * md->scale / 2;
+    const float right_x = md->sc_width * md->scale / 2 + md->center_x;
+
+    const float bottom_y = md->center_y - md->sc_height * md->scale / 2;
+
+    const float dx = (right_x - left_x) / md->sc_width;
+    const float dy = dx;
+
+    const mXXX delta = mm_delta_ps(dx);
+
+    const mXXX max_r2_packed = mm_set1_ps(MAX_R2);
+    const mXXX packed_1      = mm_set1_ps(1.);
+
+    // |dp_n| in plot units beyond which the pixel is taken as boundary one
+    const float max_der = DIST_DERIVATIVE_BAILOUT / dx;
+    const mXXX max_der2_packed = mm_set1_ps(max_der * max_der);
+
+    const mXXXi mask_for_n = mm_set1_epi32(1);
+
+    #ifdef BURNING_SHIP
+    const mXXX abs_mask = mm_castsiXXX_ps(mm_set1_epi32(~(1 << 31)));
+    #endif
+
+    for (uint32_t iy = row_begin; iy < row_end; iy++){
+        mXXX y0 = mm_set1_ps(bottom_y + iy * dy);
+
+        for (uint32_t ix = 0; ix < sc_width; ix += NUMS_IN_PACK){
+            mXXX x0 = mm_set1_ps(left_x + ix * dx);
+            x0 = mm_add_ps(x0, delta);
+
+            mXXX x = x0;
+            mXXX y = y0;
+
+            mXXX der_x = packed_1;
+            mXXX der_y = mm_set1_ps(0.);
+
+            mXXXi n = mm_set1_epi32(0);
+
+            for (uint32_t iteration = 0; iteration < iter_num; iteration++){
+                mXXX x2 = mm_mul_ps(x, x);
+                mXXX y2 = mm_mul_ps(y, y);
+
+                mXXX r2 = mm_add_ps(x2, y2);
+
+                // orbit of the pixel neighborhood has spread wider than the escape radius, so it has both escaping
+                // and not escaping points: pixel is closer than a pixel width to the set and it is not iterated anymore
+                mXXX der2 = mm_add_ps(mm_mul_ps(der_x, der_x), mm_mul_ps(der_y, der_y));
+                mXXX is_far = mm_cmple_ps(der2, max_der2_packed);
+
+                mXXX cmp_res = mm_and_ps(mm_cmple_ps(r2, max_r2_packed), is_far);
+
+                if (! mm_any_ps(cmp_res))
+                    break;
+
+                mXXXi delta_n = mm_castps_siXXX(cmp_res);
+                delta_n = mm_and_siXXX(delta_n, mask_for_n);
+
+                n = mm_add_epi32(n, delta_n);
+
+                // escaped and boundary points are frozen so their p_n and dp_n stay for the estimation
+                mXXX new_der_x = mm_sub_ps(mm_mul_ps(x, der_x), mm_mul_ps(y, der_y));
+                new_der_x = mm_add_ps(mm_add_ps(new_der_x, new_der_x), packed_1);
+
+                mXXX new_der_y = mm_add_ps(mm_mul_ps(x, der_y), mm_mul_ps(y, der_x));
+                new_der_y = mm_add_ps(new_der_y, new_der_y);
+
+                mXXX _2xy = mm_mul_ps(x, y);
+                _2xy = mm_add_ps(_2xy, _2xy);
+
+                #ifdef BURNING_SHIP
+                    _2xy = mm_and_ps(_2xy, abs_mask);
+                #endif
+
+                mXXX new_x = mm_add_ps(mm_sub_ps(x2, y2), x0);
+                mXXX new_y = mm_add_ps(_2xy, y0);
+
+                x     = mm_blendv_ps(x,     new_x,     cmp_res);
+                y     = mm_blendv_ps(y,     new_y,     cmp_res);
+                der_x = mm_blendv_ps(der_x, new_der_x, cmp_res);
+                der_y = mm_blendv_ps(der_y, new_der_y, cmp_res);
+            }
+
+            // nums are read back right away, so they are never streamed;
+            // pack beyond the row end is not stored, rows can be calculated by different threads
+            const size_t pack_len = (ix + NUMS_IN_PACK <= sc_width) ? NUMS_IN_PACK : sc_width - ix;
+
+            uint32_t * num_addr = md->num_pixels + (size_t)iy * sc_width + ix;
+            if (pack_len < NUMS_IN_PACK){
+                uint32_t n_tail[NUMS_IN_PACK] = {};
+                mm_storeu_siXXX((mXXXi *)n_tail, n);
+                memcpy(num_addr, n_tail, pack_len * sizeof(uint32_t));
+            }
+            else if (is_aligned)
+                mm_store_siXXX((mXXXi *)num_addr, n);
+            else
+                mm_storeu_siXXX((mXXXi *)num_addr, n);
+
+            float x_arr[NUMS_IN_PACK] = {}, y_arr[NUMS_IN_PACK] = {};
+            float der_x_arr[NUMS_IN_PACK] = {}, der_y_arr[NUMS_IN_PACK] = {};
+
+            mm_storeu_ps(x_arr, x);
+            mm_storeu_ps(y_arr, y);
+            mm_storeu_ps(der_x_arr, der_x);
+            mm_storeu_ps(der_y_arr, der_y);
+
+            float * dist_addr = md->dist_pixels + (size_t)iy * sc_width + ix;
+
+            for (size_t i = 0; i < pack_len; i++){
+                const float r2 = x_arr[i] * x_arr[i] + y_arr[i] * y_arr[i];
+
+                // not escaped: the set or stopped boundary pixel
+                if (num_addr[i] == iter_num || r2 <= MAX_R2){
+                    dist_addr[i] = 0;
+                    continue;
+                }
+
+                float abs_p  = sqrtf(r2);
+                float abs_dp = sqrtf(der_x_arr[i] * der_x_arr[i] + der_y_arr[i] * der_y_arr[i]);
+
+                dist_addr[i] = abs_p * logf(abs_p) / abs_dp / dx;
+            }
+        }
+    }
+}
+
+void calcMandelbrotDistanceMultiThread(mandelbrot_context_t * md, size_t threads_num)
+{
+    assert(md);
+
+    runMultiThread(md, threads_num, calcMandelbrotDistanceRows);
+}
+
 
 #define PACK_CYCLE for (size_t i = 0; i < GCC_OPT_PACK_SIZE; i++)
 
@@ -400,7 +659,7 @@ void calcMandelbrotGCCoptimized(mandelbrot_context_t * md)
                 PACK_CYCLE y[i] = _2xy[i] + y0[i];
             }
 
-            uint32_t * start_addr = md->num_pixels + iy * sc_width + ix;
+            uint32_t * start_addr = md->num_pixels + (size_t)iy * sc_width + ix;
             PACK_CYCLE start_addr[i] = n[i];
         }
     }
@@ -443,7 +702,7 @@ void calcMandelbrotNoOptimization(mandelbrot_context_t * md)
 
             }
 
-            md->num_pixels[iy * sc_width + ix] = n;
+            md->num_pixels[(size_t)iy * sc_width + ix] = n;
         }
     }
 }
@@ -466,7 +725,12 @@ static uint32_t numToColor(const uint32_t num, const uint32_t iter_num)
     return color;
 }
 
-static void calculateColorTable(const mandelbrot_context_t * md)
+const char * simdBackendName()
+{
+    return SIMD_BACKEND_NAME;
+}
+
+void calculateColorTable(const mandelbrot_context_t * md)
 {
     assert(md);
 
@@ -479,7 +743,7 @@ void numsToColor(const mandelbrot_context_t * md)
 {
     assert(md);
 
-    const uint32_t len = md->sc_height * md->sc_width;
+    const size_t len = (size_t)md->sc_height * md->sc_width;
     const uint32_t iter_num = md->iter_num;
 
     uint32_t * color_pixels = md->color_pixels;
@@ -487,10 +751,156 @@ void numsToColor(const mandelbrot_context_t * md)
 
     uint32_t * num_pixels   = md->num_pixels;
 
-    for (uint32_t num_index = 0; num_index < len; num_index++){
-        if (num_pixels[num_index] == iter_num)
+    size_t num_index = 0;
+
+  #ifdef SIMD_BACKEND_AVX
+    const bool is_aligned = (uintptr_t)color_pixels % PACK_SIZE == 0;
+
+    static_assert((COLOR_TABLE_LEN & (COLOR_TABLE_LEN - 1)) == 0, "COLOR_TABLE_LEN must be a power of 2");
+
+    const __m256i iter_num_packed = _mm256_set1_epi32(iter_num);
+    const __m256i table_mask      = _mm256_set1_epi32(COLOR_TABLE_LEN - 1);
+
+    for (; num_index + NUMS_IN_PACK <= len; num_index += NUMS_IN_PACK){
+        __m256i nums = _mm256_loadu_si256((const __m256i *)(num_pixels + num_index));
+
+        __m256i colors = _mm256_i32gather_epi32((const int *)color_table, _mm256_and_si256(nums, table_mask), sizeof(uint32_t));
+
+        // points of the set are black
+        __m256i is_inside = _mm256_cmpeq_epi32(nums, iter_num_packed);
+        colors = _mm256_andnot_si256(is_inside, colors);
+
+        STORE_NUMS((__m256i *)(color_pixels + num_index), colors, is_aligned);
+    }
+    STORE_FENCE();
+  #endif
+
+    for (; num_index < len; num_index++){
+        color_pixels[num_index] = numToColorCode(color_table, num_pixels[num_index], iter_num);
+    }
+}
+
+void distToColor(const mandelbrot_context_t * md)
+{
+    assert(md);
+    assert(md->dist_pixels);
+
+    const size_t len = (size_t)md->sc_height * md->sc_width;
+    const uint32_t iter_num = md->iter_num;
+
+    uint32_t * color_pixels = md->color_pixels;
+    uint32_t * color_table  = md->color_table;
+
+    uint32_t * num_pixels   = md->num_pixels;
+    float    * dist_pixels  = md->dist_pixels;
+
+    for (size_t num_index = 0; num_index < len; num_index++){
+        float dist = dist_pixels[num_index];
+
+        // too close to the set to be resolved, it is boundary whatever the escape number is
+        if (dist < DIST_BOUNDARY_PIXELS){
             color_pixels[num_index] = 0;
-        else
-            color_pixels[num_index] = color_table[num_pixels[num_index] % COLOR_TABLE_LEN];
+            continue;
+        }
+
+        uint32_t color = numToColorCode(color_table, num_pixels[num_index], iter_num);
+
+        if (dist < DIST_SHADE_PIXELS){
+            uint32_t brightness = (uint32_t)(256 * sqrtf(dist / DIST_SHADE_PIXELS));
+
+            uint32_t red   = ((color      ) & 0xFF) * brightness >> 8;
+            uint32_t green = ((color >>  8) & 0xFF) * brightness >> 8;
+            uint32_t blue  = ((color >> 16) & 0xFF) * brightness >> 8;
+
+            color = (color & 0xFF000000) | (blue << 16) | (green << 8) | red;
+        }
+
+        color_pixels[num_index] = color;
     }
 }
+
+uint32_t estimateIterNumByDistance(const mandelbrot_context_t * md)
+{
+    assert(md);
+    assert(md->dist_pixels);
+
+    // limit is changed by powers of 2 so it does not jitter from frame to frame
+    const uint32_t MIN_ITER_NUM = 64;
+    const uint32_t MAX_ITER_NUM = 1 << 16;
+
+    // share of unresolved pixels that is worth raising the limit
+    const double UNRESOLVED_SHARE = 1e-3;
+
+    // share of the latest escaping resolved pixels which are not taken into account (single outliers do not move the limit)
+    const double FAR_OUTLIER_SHARE = 1e-4;
+
+    // escape numbers are counted in buckets of 1/FAR_BUCKETS_NUM of the limit, the limit is changed
+    // by comparing them with quarters of it, so the number of buckets is a multiple of 4
+    const uint32_t FAR_BUCKETS_NUM = 64;
+
+    const uint32_t sc_width  = md->sc_width;
+    const uint32_t sc_height = md->sc_height;
+    const uint32_t iter_num  = md->iter_num;
+
+    assert(iter_num > 0);
+
+    const uint32_t * num_pixels  = md->num_pixels;
+    const float    * dist_pixels = md->dist_pixels;
+
+    // histogram of escape numbers of resolved pixels
+    size_t far_buckets[FAR_BUCKETS_NUM] = {};
+
+    size_t unresolved_num = 0;
+    size_t far_pixels_num = 0;
+
+    for (uint32_t iy = 0; iy < sc_height; iy++){
+        for (uint32_t ix = 0; ix < sc_width; ix++){
+            const size_t index = (size_t)iy * sc_width + ix;
+
+            if (num_pixels[index] != iter_num){
+                if (dist_pixels[index] >= DIST_BOUNDARY_PIXELS){
+                    far_buckets[(uint64_t)num_pixels[index] * FAR_BUCKETS_NUM / iter_num]++;
+                    far_pixels_num++;
+                }
+
+                continue;
+            }
+
+            // estimation is Lipschitz: if neighbor is further than 1 + DIST_BOUNDARY_PIXELS from the set,
+            // this pixel is outside the set and further than DIST_BOUNDARY_PIXELS, so it needs more iterations
+            float max_neighbor_dist = 0;
+            if (ix > 0)             max_neighbor_dist = fmaxf(max_neighbor_dist, dist_pixels[index - 1]);
+            if (ix + 1 < sc_width)  max_neighbor_dist = fmaxf(max_neighbor_dist, dist_pixels[index + 1]);
+            if (iy > 0)             max_neighbor_dist = fmaxf(max_neighbor_dist, dist_pixels[index - sc_width]);
+            if (iy + 1 < sc_height) max_neighbor_dist = fmaxf(max_neighbor_dist, dist_pixels[index + sc_width]);
+
+            if (max_neighbor_dist > DIST_BOUNDARY_PIXELS + 1)
+                unresolved_num++;
+        }
+    }
+
+    // bucket of escape numbers of resolved pixels which only FAR_OUTLIER_SHARE of them exceed
+    uint32_t max_far_bucket = FAR_BUCKETS_NUM - 1;
+    size_t later_pixels_num = 0;
+
+    while (max_far_bucket > 0 && later_pixels_num + far_buckets[max_far_bucket] <= FAR_OUTLIER_SHARE * far_pixels_num){
+        later_pixels_num += far_buckets[max_far_bucket];
+        max_far_bucket--;
+    }
+
+    // resolved pixels escaping right before the limit (in its last quarter) mean there are more of them beyond it
+    bool limit_is_low = (unresolved_num > UNRESOLVED_SHARE * sc_width * sc_height) || (4 * max_far_bucket >= 3 * FAR_BUCKETS_NUM);
+
+    if (limit_is_low)
+        return (2 * iter_num < MAX_ITER_NUM) ? 2 * iter_num : MAX_ITER_NUM;
+
+    // all resolved pixels escape in the first quarter of the limit, so it can be lowered
+    if (4 * (max_far_bucket + 1) <= FAR_BUCKETS_NUM && iter_num / 2 >= MIN_ITER_NUM)
+        return iter_num / 2;
+
+    return iter_num;
+}
+
+#ifdef SIMD_NAMESPACE
+}
+#endif
@@ -0,0 +1,602 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "mandelbrot_engine.h"
+#include "mandelbrot.h"
+#include "frame_alloc.h"
+
+struct render_job {
+    render_engine_t * engine;
+
+    // view and target in the form the kernels take
+    mandelbrot_context_t md;
+
+    uint32_t tiles_num;
+    uint32_t given_tiles;
+    uint32_t running_tiles;
+
+    // tiles [band_next[i], band_end[i]) are in the band of the target placed for worker i, it takes them first
+    uint32_t bands_num;
+    uint32_t band_next[ENGINE_MAX_THREADS];
+    uint32_t band_end [ENGINE_MAX_THREADS];
+
+    bool * tiles_done;
+    uint32_t done_tiles;
+
+    bool is_cancelled;
+    render_status_t status;
+
+    pthread_cond_t finished_cond;
+
+    render_job_t * next;
+    render_job_t * next_owned;
+};
+
+typedef struct {
+    render_engine_t * engine;
+    size_t thread_index;
+} worker_arg_t;
+
+struct render_engine {
+    pthread_t    workers    [ENGINE_MAX_THREADS];
+    worker_arg_t worker_args[ENGINE_MAX_THREADS];
+    size_t threads_num;
+    size_t active_threads_num;      // workers with greater indexes sleep and take no tiles
+
+    pthread_mutex_t mutex;
+    pthread_cond_t  work_cond;
+
+    // jobs with tiles to render, the one which gave the last tile is moved to the end,
+    // so concurrent jobs share the workers equally
+    render_job_t * first_job;
+    render_job_t * last_job;
+
+    // all submitted jobs which are not released, they are freed by the destructor
+    render_job_t * owned_jobs;
+
+    bool is_stopping;
+
+    uint32_t * color_table;
+};
+
+static void * workerLoop(void * arg_ptr);
+
+static void splitTilesByBands(render_job_t * job, const render_target_t * target);
+
+static render_job_t * takeTile(render_engine_t * engine, const size_t thread_index, uint32_t * tile_index);
+
+static void renderTile(const render_job_t * job, const uint32_t tile_index);
+
+static void finishJobIfDone(render_job_t * job);
+
+static void removeJob(render_engine_t * engine, render_job_t * job);
+
+static void removeOwnedJob(render_engine_t * engine, render_job_t * job);
+
+static void freeJob(render_job_t * job);
+
+
+mandelbrot_view_t defaultView(const uint32_t width)
+{
+    mandelbrot_view_t view = {
+        .center_x = DEFAULT_CENTER_X,
+        .center_y = DEFAULT_CENTER_Y,
+        .scale    = DEFAULT_PLOT_WIDTH / width,
+        .iter_num = DEFAULT_ITER_NUM
+    };
+
+    return view;
+}
+
+render_target_t renderTargetCtor(const uint32_t width, const uint32_t height, const size_t workers_num)
+{
+    render_target_t target = {};
+    target.workers_num = workers_num;
+
+    renderTargetResize(&target, width, height);
+
+    return target;
+}
+
+void renderTargetResize(render_target_t * target, const uint32_t width, const uint32_t height)
+{
+    assert(target);
+
+    const size_t pixels_num = (size_t)width * height;
+
+    if (pixels_num > target->capacity){
+        frameFree(target->num_pixels);
+        frameFree(target->color_pixels);
+
+        // pages of band i are touched by the thread bound to the cpu of worker i (see splitTilesByBands)
+        target->num_pixels   = (uint32_t *)frameAlloc((pixels_num + FRAME_PADDING_PIXELS) * sizeof(uint32_t), target->workers_num);
+        target->color_pixels = (uint32_t *)frameAlloc((pixels_num + FRAME_PADDING_PIXELS) * sizeof(uint32_t), target->workers_num);
+
+        target->capacity = pixels_num;
+    }
+
+    target->width  = width;
+    target->height = height;
+}
+
+void renderTargetDtor(render_target_t * target)
+{
+    assert(target);
+
+    frameFree(target->num_pixels);
+    frameFree(target->color_pixels);
+
+    memset(target, 0, sizeof(*target));
+}
+
+render_engine_t * renderEngineCtor(const size_t threads_num)
+{
+    assert(threads_num > 0 && threads_num <= ENGINE_MAX_THREADS);
+
+    render_engine_t * engine = (render_engine_t *)calloc(1, sizeof(*engine));
+    if (! engine){
+        fprintf(stderr, "ERROR: Could not allocate memory for render engine\n");
+        return NULL;
+    }
+
+    engine->color_table = (uint32_t *)frameAlloc(COLOR_TABLE_LEN * sizeof(uint32_t), 1);
+
+    mandelbrot_context_t table_md = {};
+    table_md.color_table = engine->color_table;
+    table_md.iter_num    = DEFAULT_ITER_NUM;
+    calculateColorTable(&table_md);
+
+    pthread_mutex_init(&engine->mutex, NULL);
+    pthread_cond_init(&engine->work_cond, NULL);
+
+    engine->threads_num        = threads_num;
+    engine->active_threads_num = threads_num;
+
+    for (size_t thread_index = 0; thread_index < threads_num; thread_index++){
+        engine->worker_args[thread_index].engine       = engine;
+        engine->worker_args[thread_index].thread_index = thread_index;
+
+        pthread_create(engine->workers + thread_index, NULL, workerLoop, engine->worker_args + thread_index);
+    }
+
+    return engine;
+}
+
+void renderEngineDtor(render_engine_t * engine)
+{
+    assert(engine);
+
+    pthread_mutex_lock(&engine->mutex);
+
+    for (render_job_t * job = engine->owned_jobs; job; job = job->next_owned){
+        if (job->status == RENDER_IN_PROGRESS){
+            job->is_cancelled = true;
+            finishJobIfDone(job);
+        }
+    }
+
+    engine->is_stopping = true;
+    pthread_cond_broadcast(&engine->work_cond);
+
+    pthread_mutex_unlock(&engine->mutex);
+
+    // workers finish their running tiles before they exit, so nothing uses the jobs after that
+    for (size_t thread_index = 0; thread_index < engine->threads_num; thread_index++){
+        pthread_join(engine->workers[thread_index], NULL);
+    }
+
+    while (engine->owned_jobs){
+        render_job_t * job = engine->owned_jobs;
+        engine->owned_jobs = job->next_owned;
+
+        freeJob(job);
+    }
+
+    pthread_mutex_destroy(&engine->mutex);
+    pthread_cond_destroy(&engine->work_cond);
+
+    frameFree(engine->color_table);
+    free(engine);
+}
+
+void renderSetActiveThreads(render_engine_t * engine, size_t threads_num)
+{
+    assert(engine);
+
+    if (threads_num < 1)
+        threads_num = 1;
+    if (threads_num > engine->threads_num)
+        threads_num = engine->threads_num;
+
+    pthread_mutex_lock(&engine->mutex);
+
+    // woken workers take tiles of running jobs too
+    if (threads_num > engine->active_threads_num)
+        pthread_cond_broadcast(&engine->work_cond);
+
+    engine->active_threads_num = threads_num;
+
+    pthread_mutex_unlock(&engine->mutex);
+}
+
+size_t renderActiveThreads(render_engine_t * engine)
+{
+    assert(engine);
+
+    pthread_mutex_lock(&engine->mutex);
+    size_t threads_num = engine->active_threads_num;
+    pthread_mutex_unlock(&engine->mutex);
+
+    return threads_num;
+}
+
+render_job_t * renderSubmit(render_engine_t * engine, const mandelbrot_view_t * view, render_target_t * target)
+{
+    assert(engine);
+    assert(view);
+    assert(target);
+
+    render_job_t * job = (render_job_t *)calloc(1, sizeof(*job));
+    if (! job){
+        fprintf(stderr, "ERROR: Could not allocate memory for render job\n");
+        return NULL;
+    }
+
+    job->engine = engine;
+
+    job->md.num_pixels   = target->num_pixels;
+    job->md.color_pixels = target->color_pixels;
+    job->md.color_table  = engine->color_table;
+
+    job->md.center_x = view->center_x;
+    job->md.center_y = view->center_y;
+    job->md.scale    = view->scale;
+    job->md.iter_num = view->iter_num;
+
+    job->md.sc_width  = target->width;
+    job->md.sc_height = target->height;
+
+    job->tiles_num  = (target->height + ENGINE_TILE_ROWS - 1) / ENGINE_TILE_ROWS;
+    job->tiles_done = (bool *)calloc(job->tiles_num + 1, sizeof(bool));
+    job->status     = RENDER_IN_PROGRESS;
+
+    if (! job->tiles_done){
+        fprintf(stderr, "ERROR: Could not allocate memory for render job\n");
+        free(job);
+        return NULL;
+    }
+
+    pthread_cond_init(&job->finished_cond, NULL);
+
+    job->bands_num = (target->workers_num < engine->threads_num) ? target->workers_num : engine->threads_num;
+    splitTilesByBands(job, target);
+
+    pthread_mutex_lock(&engine->mutex);
+
+    job->next_owned    = engine->owned_jobs;
+    engine->owned_jobs = job;
+
+    if (job->tiles_num == 0){
+        job->status = RENDER_DONE;
+    }
+    else {
+        if (engine->last_job)
+            engine->last_job->next = job;
+        else
+            engine->first_job = job;
+
+        engine->last_job = job;
+
+        pthread_cond_broadcast(&engine->work_cond);
+    }
+
+    pthread_mutex_unlock(&engine->mutex);
+
+    return job;
+}
+
+void renderCancel(render_job_t * job)
+{
+    assert(job);
+
+    render_engine_t * engine = job->engine;
+
+    pthread_mutex_lock(&engine->mutex);
+
+    if (job->status == RENDER_IN_PROGRESS){
+        job->is_cancelled = true;
+        finishJobIfDone(job);
+    }
+
+    pthread_mutex_unlock(&engine->mutex);
+}
+
+render_status_t renderStatus(render_job_t * job)
+{
+    assert(job);
+
+    pthread_mutex_lock(&job->engine->mutex);
+    render_status_t status = job->status;
+    pthread_mutex_unlock(&job->engine->mutex);
+
+    return status;
+}
+
+uint32_t renderTilesNum(const render_job_t * job)
+{
+    assert(job);
+
+    return job->tiles_num;
+}
+
+uint32_t renderDoneTiles(render_job_t * job, bool * tiles_done)
+{
+    assert(job);
+    assert(tiles_done);
+
+    pthread_mutex_lock(&job->engine->mutex);
+
+    memcpy(tiles_done, job->tiles_done, job->tiles_num * sizeof(bool));
+    uint32_t done_tiles = job->done_tiles;
+
+    pthread_mutex_unlock(&job->engine->mutex);
+
+    return done_tiles;
+}
+
+render_status_t renderWait(render_job_t * job)
+{
+    assert(job);
+
+    render_engine_t * engine = job->engine;
+
+    pthread_mutex_lock(&engine->mutex);
+
+    while (job->status == RENDER_IN_PROGRESS){
+        pthread_cond_wait(&job->finished_cond, &engine->mutex);
+    }
+
+    render_status_t status = job->status;
+
+    pthread_mutex_unlock(&engine->mutex);
+
+    return status;
+}
+
+render_status_t renderRelease(render_job_t * job)
+{
+    if (! job)
+        return RENDER_CANCELLED;
+
+    render_status_t status = renderWait(job);
+
+    pthread_mutex_lock(&job->engine->mutex);
+    removeOwnedJob(job->engine, job);
+    pthread_mutex_unlock(&job->engine->mutex);
+
+    freeJob(job);
+
+    return status;
+}
+
+render_status_t renderView(render_engine_t * engine, const mandelbrot_view_t * view, render_target_t * target)
+{
+    return renderRelease(renderSubmit(engine, view, target));
+}
+
+static void * workerLoop(void * arg_ptr)
+{
+    assert(arg_ptr);
+
+    worker_arg_t * arg = (worker_arg_t *)arg_ptr;
+    render_engine_t * engine = arg->engine;
+
+    bindThreadToCpu(arg->thread_index);
+
+    pthread_mutex_lock(&engine->mutex);
+
+    while (true){
+        uint32_t tile_index = 0;
+        render_job_t * job = (arg->thread_index < engine->active_threads_num) ? takeTile(engine, arg->thread_index, &tile_index) : NULL;
+
+        if (! job){
+            if (engine->is_stopping)
+                break;
+
+            pthread_cond_wait(&engine->work_cond, &engine->mutex);
+            continue;
+        }
+
+        pthread_mutex_unlock(&engine->mutex);
+        renderTile(job, tile_index);
+        pthread_mutex_lock(&engine->mutex);
+
+        job->running_tiles--;
+        job->tiles_done[tile_index] = true;
+        job->done_tiles++;
+
+        finishJobIfDone(job);
+    }
+
+    pthread_mutex_unlock(&engine->mutex);
+
+    return NULL;
+}
+
+/// @brief divides tiles of the job into bands of the target: tile belongs to the worker whose part of the buffers
+///        (as they are touched by frameAlloc) holds its first pixel, frames smaller than the buffers are in the first bands
+static void splitTilesByBands(render_job_t * job, const render_target_t * target)
+{
+    assert(job);
+    assert(target);
+
+    if (job->bands_num <= 1){
+        job->bands_num   = 1;
+        job->band_end[0] = job->tiles_num;
+        return;
+    }
+
+    const size_t buffer_pixels = target->capacity + FRAME_PADDING_PIXELS;
+
+    for (uint32_t tile_index = 0; tile_index < job->tiles_num; tile_index++){
+        const size_t first_pixel = (size_t)tile_index * ENGINE_TILE_ROWS * target->width;
+        const size_t band = first_pixel * job->bands_num / buffer_pixels;
+
+        // bands go one after another, so the first tile of a band is its beginning
+        if (job->band_end[band] == 0)
+            job->band_next[band] = tile_index;
+
+        job->band_end[band] = tile_index + 1;
+    }
+}
+
+/// @brief takes next tile of the first job and moves the job to the end of the queue (engine mutex must be locked);
+///        worker takes tiles of its own band, when they are over it helps with the band which has the most tiles left
+static render_job_t * takeTile(render_engine_t * engine, const size_t thread_index, uint32_t * tile_index)
+{
+    assert(engine);
+    assert(tile_index);
+
+    render_job_t * job = engine->first_job;
+
+    // cancelled jobs give no more tiles
+    while (job && job->is_cancelled){
+        removeJob(engine, job);
+        job = engine->first_job;
+    }
+
+    if (! job)
+        return NULL;
+
+    size_t band = thread_index;
+
+    if (band >= job->bands_num || job->band_next[band] == job->band_end[band]){
+        band = 0;
+
+        for (size_t band_index = 1; band_index < job->bands_num; band_index++){
+            if (job->band_end[band_index] - job->band_next[band_index] > job->band_end[band] - job->band_next[band])
+                band = band_index;
+        }
+    }
+
+    assert(job->band_next[band] < job->band_end[band]);
+
+    *tile_index = job->band_next[band]++;
+    job->given_tiles++;
+    job->running_tiles++;
+
+    // the job stays in the queue only while it has tiles to give
+    removeJob(engine, job);
+
+    if (job->given_tiles < job->tiles_num){
+        if (engine->last_job)
+            engine->last_job->next = job;
+        else
+            engine->first_job = job;
+
+        engine->last_job = job;
+    }
+
+    return job;
+}
+
+static void renderTile(const render_job_t * job, const uint32_t tile_index)
+{
+    assert(job);
+
+    const uint32_t row_begin = tile_index * ENGINE_TILE_ROWS;
+    const uint32_t row_end   = (row_begin + ENGINE_TILE_ROWS < job->md.sc_height) ? row_begin + ENGINE_TILE_ROWS : job->md.sc_height;
+
+    calcMandelbrotConveyorRows(&job->md, row_begin, row_end);
+
+    if (! job->md.color_pixels)
+        return;
+
+    // coloring does not depend on the position, so the tile is colored as a separate frame
+    mandelbrot_context_t tile_md = job->md;
+
+    tile_md.num_pixels   += (size_t)row_begin * tile_md.sc_width;
+    tile_md.color_pixels += (size_t)row_begin * tile_md.sc_width;
+    tile_md.sc_height     = row_end - row_begin;
+
+    numsToColor(&tile_md);
+}
+
+/// @brief finishes the job if there are no tiles left and none is running (engine mutex must be locked)
+static void finishJobIfDone(render_job_t * job)
+{
+    assert(job);
+
+    if (job->status != RENDER_IN_PROGRESS || job->running_tiles > 0)
+        return;
+
+    if (job->is_cancelled){
+        removeJob(job->engine, job);
+        job->status = RENDER_CANCELLED;
+    }
+    else if (job->given_tiles == job->tiles_num){
+        job->status = RENDER_DONE;
+    }
+    else
+        return;
+
+    pthread_cond_broadcast(&job->finished_cond);
+}
+
+/// @brief removes job from the queue if it is there (engine mutex must be locked)
+static void removeJob(render_engine_t * engine, render_job_t * job)
+{
+    assert(engine);
+    assert(job);
+
+    render_job_t * prev_job = NULL;
+    render_job_t * cur_job  = engine->first_job;
+
+    while (cur_job && cur_job != job){
+        prev_job = cur_job;
+        cur_job  = cur_job->next;
+    }
+
+    if (! cur_job)
+        return;
+
+    if (prev_job)
+        prev_job->next = job->next;
+    else
+        engine->first_job = job->next;
+
+    if (engine->last_job == job)
+        engine->last_job = prev_job;
+
+    job->next = NULL;
+}
+
+/// @brief removes job from the list of not released ones (engine mutex must be locked)
+static void removeOwnedJob(render_engine_t * engine, render_job_t * job)
+{
+    assert(engine);
+    assert(job);
+
+    render_job_t ** link = &engine->owned_jobs;
+
+    while (*link && *link != job)
+        link = &(*link)->next_owned;
+
+    if (*link)
+        *link = job->next_owned;
+
+    job->next_owned = NULL;
+}
+
+static void freeJob(render_job_t * job)
+{
+    assert(job);
+
+    pthread_cond_destroy(&job->finished_cond);
+    free(job->tiles_done);
+    free(job);
+}
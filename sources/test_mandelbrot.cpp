@@ -2,10 +2,36 @@
 #include <stdlib.h>
 #include <time.h>
 #include <math.h>
+#include <string.h>
+#include <pthread.h>
 #include <assert.h>
 
 #include "test_mandelbrot.h"
 #include "mandelbrot.h"
+#include "antialiasing.h"
+#include "iter_probe.h"
+#include "mandelbrot_engine.h"
+#include "buddhabrot.h"
+#include "distributed.h"
+#include "iter_file.h"
+#include "frame_alloc.h"
+
+// pool of renderEngine8Workers, it is created by the first call and destroyed by releaseTestEngine
+static render_engine_t * test_engine = NULL;
+
+static render_engine_t * testEngine();
+
+static void releaseTestEngine();
+
+static mandelbrot_view_t contextView(const mandelbrot_context_t * md);
+
+static void renderEngine3ActiveWorkers(mandelbrot_context_t * md);
+
+static void renderEngine4Submitters(mandelbrot_context_t * md);
+
+static bool testEngineJobs();
+
+static void calcMandelbrotGeneric8Threads(mandelbrot_context_t * md);
 
 test_result_t testMandelbrotFunc(void (*mandelFunction)(mandelbrot_context_t * md),  mandelbrot_context_t * md, const size_t measure_time)
 {
@@ -62,7 +88,15 @@ void testMandelbrot(mandelbrot_context_t * md, const size_t measure_time)
         {"COMPILER OPTIMIZATION", calcMandelbrotGCCoptimized    },
         {"INTRINSICS"           , calcMandelbrot                },
         {"INTRINSICS + CONVEYOR", calcMandelbrotConveyor        },
-        {"INTRINSICS 8 THREADS ", calcMandelbrot8Threads        }
+        {"GENERIC BACKEND + CONVEYOR", simd_generic::calcMandelbrotConveyor},
+        {"INTRINSICS + DISTANCE", calcMandelbrotDistance        },
+        {"GENERIC BACKEND + DISTANCE", simd_generic::calcMandelbrotDistance},
+        {"INTRINSICS 8 THREADS ", calcMandelbrot8Threads        },
+        {"GENERIC BACKEND 8 THREADS", calcMandelbrotGeneric8Threads},
+        {"8 THREADS + COLORING ", calcMandelbrot8ThreadsColored },
+        {"ENGINE 8 WORKERS + COLORING", renderEngine8Workers    },
+        {"8 THREADS + COLORING + ANTIALIASING", calcMandelbrot8ThreadsAntialiased},
+        {"ITERATION LIMIT PROBE", probeIterNumOnly}
     };
     const size_t test_num = sizeof(tests) / sizeof(*tests);
 
@@ -71,6 +105,514 @@ void testMandelbrot(mandelbrot_context_t * md, const size_t measure_time)
         printFuncTime(tests[test_index].mandelFunction, md, measure_time);
         printf("\n");
     }
+
+    releaseTestEngine();
+}
+
+void testBuddhabrot(mandelbrot_context_t * md, const size_t samples_num)
+{
+    struct test_mode {
+        const char * mode_name;
+        bool is_nebula;
+        bool is_metropolis;
+    };
+
+    const struct test_mode modes[] = {
+        {"BUDDHABROT UNIFORM"   , false, false},
+        {"BUDDHABROT METROPOLIS", false, true },
+        {"NEBULABROT UNIFORM"   , true , false},
+        {"NEBULABROT METROPOLIS", true , true }
+    };
+    const size_t modes_num = sizeof(modes) / sizeof(*modes);
+
+    for (size_t mode_index = 0; mode_index < modes_num; mode_index++){
+        buddhabrot_params_t params = {
+            .samples_num   = samples_num,
+            .threads_num   = 8,
+            .is_nebula     = modes[mode_index].is_nebula,
+            .is_metropolis = modes[mode_index].is_metropolis
+        };
+
+        buddhabrot_stats_t stats = renderBuddhabrot(md, &params);
+
+        printf("%s\n", modes[mode_index].mode_name);
+        printf("render time = %lf ms, %zu samples, %zu orbits, %zu points in view\n",
+            stats.time, stats.samples, stats.orbits, stats.points);
+        printf("throughput = %.3lf Morbits/s, %.3lf Mpoints/s\n\n",
+            stats.orbits_per_sec / 1e6, stats.points / stats.time / 1e3);
+    }
+}
+
+void testDistributed(mandelbrot_context_t * md, const coordinator_params_t * params, const size_t frames_num)
+{
+    assert(md);
+    assert(params);
+
+    coordinator_t * coord = coordinatorCtor(params);
+    if (! coord)
+        return;
+
+    printf("coordinator listens on port %u, %zu local workers, waiting for %zu workers\n\n",
+        coordinatorPort(coord), params->local_workers_num, params->min_workers_num);
+
+    // reference frame is rendered locally to check assembled frames
+    mandelbrot_context_t local_md = mandelbrotCtor(md->sc_width, md->sc_height);
+    calcMandelbrotConveyor(&local_md);
+
+    for (size_t frame_index = 0; frame_index < frames_num; frame_index++){
+        coordinator_stats_t stats = {};
+
+        if (! coordinatorRender(coord, md, &stats))
+            break;
+
+        size_t mismatches = 0;
+        for (size_t pixel_index = 0; pixel_index < (size_t)md->sc_width * md->sc_height; pixel_index++){
+            if (md->num_pixels[pixel_index] != local_md.num_pixels[pixel_index])
+                mismatches++;
+        }
+
+        printf("FRAME %zu: %lf ms, %zu tiles, %zu retried, %zu speculative, %zu pixels differ from local render\n",
+            frame_index, stats.time, stats.tiles, stats.retried_tiles, stats.speculative_tiles, mismatches);
+
+        for (size_t worker_index = 0; worker_index < stats.workers_num; worker_index++){
+            const worker_stats_t * worker = stats.workers + worker_index;
+
+            printf("    %-24s %4zu tiles, busy %8.2lf ms, %7.2lf Mpixels/s%s\n",
+                worker->name, worker->tiles, worker->busy_time,
+                (worker->busy_time > 0) ? worker->pixels / worker->busy_time / 1e3 : 0.,
+                worker->is_dead ? " (dead)" : "");
+        }
+    }
+
+    mandelbrotDtor(&local_md);
+    coordinatorDtor(coord);
+}
+
+void testIterFileSave(const char * file_name, const uint32_t width, const uint32_t height)
+{
+    assert(file_name);
+
+    // frame is rendered by bands, so only one band is kept in memory
+    const uint32_t band_rows = ITER_TILE_SIZE * 4;
+
+    mandelbrot_context_t md = mandelbrotCtor(0, 0);
+    md.sc_width  = width;
+    md.sc_height = height;
+    md.scale     = DEFAULT_PLOT_WIDTH / width;
+
+    uint32_t * band = (uint32_t *)frameAlloc(((size_t)band_rows * width + FRAME_PADDING_PIXELS) * sizeof(uint32_t), 1);
+
+    iter_writer_t * writer = iterWriterCtor(file_name, &md);
+
+    double calc_time  = 0;
+    double write_time = 0;
+
+    for (uint32_t row_begin = 0; writer && row_begin < height; row_begin += band_rows){
+        const uint32_t row_end = (row_begin + band_rows < height) ? row_begin + band_rows : height;
+
+        clock_t calc_start = clock();
+        calcMandelbrotConveyorTile(&md, row_begin, row_end, band);
+        clock_t write_start = clock();
+        iterWriterAddRows(writer, band, row_end - row_begin);
+        clock_t write_end = clock();
+
+        calc_time  += 1000. * (write_start - calc_start) / CLOCKS_PER_SEC;
+        write_time += 1000. * (write_end - write_start) / CLOCKS_PER_SEC;
+    }
+
+    if (writer && iterWriterDtor(writer)){
+        iter_file_t * file = iterFileOpen(file_name);
+
+        if (file){
+            const iter_file_header_t * header = iterFileHeader(file);
+            const size_t raw_size  = (size_t)width * height * sizeof(uint32_t);
+            const size_t file_size = header->index_offset + (size_t)header->tiles_x * header->tiles_y * sizeof(iter_tile_entry_t);
+
+            printf("%ux%u frame is written to '%s'\n", width, height, file_name);
+            printf("render time = %lf ms, encoding and writing time = %lf ms\n", calc_time, write_time);
+            printf("file size = %zu bytes, %.3lf bits per pixel, %.1lf times less than raw data\n\n",
+                file_size, 8. * file_size / ((double)width * height), (double)raw_size / file_size);
+
+            iterFileClose(file);
+        }
+    }
+
+    frameFree(band);
+    mandelbrotDtor(&md);
+}
+
+void testIterFileRecolor(const char * file_name, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+    assert(file_name);
+
+    iter_file_t * file = iterFileOpen(file_name);
+    if (! file)
+        return;
+
+    const iter_file_header_t * header = iterFileHeader(file);
+
+    // zero size - the whole frame
+    if (width == 0 || height == 0){
+        x = 0;
+        y = 0;
+        width  = header->width;
+        height = header->height;
+    }
+
+    if ((uint64_t)x + width > header->width || (uint64_t)y + height > header->height){
+        fprintf(stderr, "ERROR: Region %ux%u at (%u, %u) is out of %ux%u frame\n",
+            width, height, x, y, header->width, header->height);
+        iterFileClose(file);
+        return;
+    }
+
+    // region is decoded and colored by bands of whole tile rows, so huge frames are not kept in memory
+    const uint32_t band_rows = header->tile_size * 4;
+
+    mandelbrot_context_t band_md = {};
+
+    band_md.center_x  = header->center_x;
+    band_md.center_y  = header->center_y;
+    band_md.scale     = header->scale;
+    band_md.iter_num  = header->iter_num;
+    band_md.sc_width  = width;
+
+    band_md.num_pixels   = (uint32_t *)frameAlloc(((size_t)band_rows * width + FRAME_PADDING_PIXELS) * sizeof(uint32_t), 1);
+    band_md.color_pixels = (uint32_t *)frameAlloc(((size_t)band_rows * width + FRAME_PADDING_PIXELS) * sizeof(uint32_t), 1);
+    band_md.color_table  = (uint32_t *)frameAlloc(COLOR_TABLE_LEN * sizeof(uint32_t), 1);
+
+    bool is_decoded = band_md.num_pixels && band_md.color_pixels && band_md.color_table;
+
+    if (! is_decoded)
+        fprintf(stderr, "ERROR: Could not allocate memory for recoloring\n");
+    else
+        calculateColorTable(&band_md);
+
+    double decode_time = 0;
+    double color_time  = 0;
+
+    for (uint32_t band_begin = y; is_decoded && band_begin < y + height; ){
+        const uint64_t next_border = ((uint64_t)band_begin / band_rows + 1) * band_rows;
+        const uint32_t band_end    = (next_border < (uint64_t)y + height) ? (uint32_t)next_border : y + height;
+
+        struct timespec decode_start = {};
+        struct timespec color_start  = {};
+        struct timespec color_end    = {};
+
+        clock_gettime(CLOCK_MONOTONIC, &decode_start);
+        is_decoded = iterFileDecode(file, x, band_begin, width, band_end - band_begin, band_md.num_pixels, DEFAULT_THREADS_NUM);
+        clock_gettime(CLOCK_MONOTONIC, &color_start);
+
+        band_md.sc_height = band_end - band_begin;
+        numsToColor(&band_md);
+        clock_gettime(CLOCK_MONOTONIC, &color_end);
+
+        decode_time += 1000. * (color_start.tv_sec - decode_start.tv_sec) + (color_start.tv_nsec - decode_start.tv_nsec) / 1e6;
+        color_time  += 1000. * (color_end.tv_sec   - color_start.tv_sec ) + (color_end.tv_nsec   - color_start.tv_nsec ) / 1e6;
+
+        band_begin = band_end;
+    }
+
+    if (is_decoded){
+        printf("%ux%u region at (%u, %u) of %ux%u frame (iter num = %u), bands of %u rows\n",
+            width, height, x, y, header->width, header->height, header->iter_num, band_rows);
+        printf("decoding time = %lf ms (%.1lf Mpixels/s), coloring time = %lf ms\n\n",
+            decode_time, (double)width * height / decode_time / 1e3, color_time);
+    }
+
+    frameFree(band_md.num_pixels);
+    frameFree(band_md.color_pixels);
+    frameFree(band_md.color_table);
+    iterFileClose(file);
+}
+
+typedef struct {
+    const char * name;
+
+    float center_x;
+    float center_y;
+    float plot_width;
+    uint32_t iter_num;
+
+    uint32_t width;
+    uint32_t height;
+
+    // share of pixels which may differ from golden frame: coordinates of points are rounded differently by kernels,
+    // it changes chaotic pixels near the boundary (there are more of them in deep views)
+    double max_mismatch_share;
+
+    // mismatches allowed in pixels which golden neighbors all have the same number, rounding hardly ever changes them
+    size_t max_smooth_mismatches;
+} golden_view_t;
+
+// sizes are not multiples of pack sizes and thread numbers, so tails of rows and frames are checked too;
+// limits are the worst values of AVX2, SSE and generic builds with a margin (seahorse 3.4%, elephant 0.54%,
+// minibrot 0.26%, default 0.30%, tiny 1 pixel; 1 smooth mismatch of GCCoptimized in seahorse)
+static const golden_view_t GOLDEN_VIEWS[] = {
+    {"default",   DEFAULT_CENTER_X, DEFAULT_CENTER_Y, DEFAULT_PLOT_WIDTH, DEFAULT_ITER_NUM, 637, 361, 0.004, 0},
+    {"seahorse",  -0.7436f,         0.1318f,          0.01f,              512,              643, 359, 0.04,  3},
+    {"elephant",  0.2750f,          0.0070f,          0.05f,              512,              500, 301, 0.007, 1},
+    {"minibrot",  -1.7549f,         0.0f,             0.02f,              1024,             401, 233, 0.004, 1},
+    {"tiny",      -0.5f,            0.0f,             2.5f,               256,              37,  13,  0.005, 0}
+};
+
+typedef struct {
+    const char * name;
+
+    void (*calc_func)(mandelbrot_context_t * md);
+    void (*threads_func)(mandelbrot_context_t * md, size_t threads_num);
+    size_t threads_num;
+
+    // kernel which result must be matched exactly (the same arithmetic), -1 - only golden frame is compared
+    int base_index;
+
+    bool is_distance;
+} golden_kernel_t;
+
+static const golden_kernel_t GOLDEN_KERNELS[] = {
+    {"NoOptimization",         calcMandelbrotNoOptimization, NULL,                              0, -1, false},
+    {"GCCoptimized",           calcMandelbrotGCCoptimized,   NULL,                              0, -1, false},
+    {"SIMD",                   calcMandelbrot,               NULL,                              0, -1, false},
+    {"SIMD conveyor",          calcMandelbrotConveyor,       NULL,                              0, -1, false},
+    {"Generic conveyor",       simd_generic::calcMandelbrotConveyor,    NULL,                   0, -1, false},
+    {"Generic MultiThread 3",  NULL,                         simd_generic::calcMandelbrotMultiThread, 3, 3, false},
+    {"MultiThread 1",          NULL,                         calcMandelbrotMultiThread,         1,  3, false},
+    {"MultiThread 2",          NULL,                         calcMandelbrotMultiThread,         2,  3, false},
+    {"MultiThread 3",          NULL,                         calcMandelbrotMultiThread,         3,  3, false},
+    {"MultiThread 7",          NULL,                         calcMandelbrotMultiThread,         7,  3, false},
+    {"MultiThread 8",          NULL,                         calcMandelbrotMultiThread,         8,  3, false},
+    {"Distance",               calcMandelbrotDistance,       NULL,                              0, -1, true },
+    {"DistanceMultiThread 3",  NULL,                         calcMandelbrotDistanceMultiThread, 3,  9, true },
+    {"DistanceMultiThread 8",  NULL,                         calcMandelbrotDistanceMultiThread, 8,  9, true },
+    {"Engine 8 workers",       renderEngine8Workers,         NULL,                              0,  3, false},
+    {"Engine 3 of 8 workers",  renderEngine3ActiveWorkers,   NULL,                              0,  3, false},
+    {"Engine 4 submitters",    renderEngine4Submitters,      NULL,                              0,  3, false}
+};
+
+const size_t GOLDEN_VIEWS_NUM   = sizeof(GOLDEN_VIEWS)   / sizeof(*GOLDEN_VIEWS);
+const size_t GOLDEN_KERNELS_NUM = sizeof(GOLDEN_KERNELS) / sizeof(*GOLDEN_KERNELS);
+
+// value which is never calculated, pixels still having it were not written by the kernel
+const uint32_t GOLDEN_UNWRITTEN_PIXEL = UINT32_MAX;
+// boundary pixels of distance kernels: they are not iterated to the escape, so their numbers are not compared
+const uint32_t GOLDEN_FILLED_PIXEL = UINT32_MAX - 1;
+
+typedef struct {
+    size_t mismatches;
+    size_t smooth_mismatches;   // in pixels which reference neighbors all have the same number (away from the boundary)
+    size_t unwritten;
+    size_t filled;
+    uint32_t max_deviation;
+} golden_diff_t;
+
+/// @brief reference pixel and all its neighbors have the same number, so rounding of coordinates cannot change it
+static bool isSmoothPixel(const uint32_t * ref_nums, const uint32_t width, const uint32_t height, const uint32_t ix, const uint32_t iy)
+{
+    assert(ref_nums);
+
+    const uint32_t num = ref_nums[(size_t)iy * width + ix];
+
+    for (uint32_t ny = (iy > 0) ? iy - 1 : 0; ny <= iy + 1 && ny < height; ny++){
+        for (uint32_t nx = (ix > 0) ? ix - 1 : 0; nx <= ix + 1 && nx < width; nx++){
+            if (ref_nums[(size_t)ny * width + nx] != num)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static golden_diff_t compareNums(const uint32_t * nums, const uint32_t * ref_nums, const uint32_t width, const uint32_t height)
+{
+    assert(nums);
+    assert(ref_nums);
+
+    golden_diff_t diff = {};
+
+    const size_t pixels_num = (size_t)width * height;
+
+    for (size_t pixel_index = 0; pixel_index < pixels_num; pixel_index++){
+        if (nums[pixel_index] == GOLDEN_UNWRITTEN_PIXEL){
+            diff.unwritten++;
+            continue;
+        }
+
+        if (nums[pixel_index] == GOLDEN_FILLED_PIXEL){
+            diff.filled++;
+            continue;
+        }
+
+        if (nums[pixel_index] == ref_nums[pixel_index])
+            continue;
+
+        const uint32_t deviation = (nums[pixel_index] > ref_nums[pixel_index]) ? nums[pixel_index] - ref_nums[pixel_index]
+                                                                               : ref_nums[pixel_index] - nums[pixel_index];
+        diff.mismatches++;
+        if (deviation > diff.max_deviation)
+            diff.max_deviation = deviation;
+
+        if (isSmoothPixel(ref_nums, width, height, pixel_index % width, pixel_index / width))
+            diff.smooth_mismatches++;
+    }
+
+    return diff;
+}
+
+static bool loadGoldenFrame(const char * file_name, const mandelbrot_context_t * md, uint32_t * golden_nums)
+{
+    assert(file_name);
+    assert(md);
+    assert(golden_nums);
+
+    iter_file_t * file = iterFileOpen(file_name);
+    if (! file)
+        return false;
+
+    const iter_file_header_t * header = iterFileHeader(file);
+
+    bool is_loaded = header->width == md->sc_width && header->height == md->sc_height
+                  && header->center_x == md->center_x && header->center_y == md->center_y
+                  && header->scale == md->scale && header->iter_num == md->iter_num;
+
+    if (! is_loaded)
+        fprintf(stderr, "ERROR: golden frame '%s' has another view, it must be updated\n", file_name);
+    else
+        is_loaded = iterFileDecode(file, 0, 0, md->sc_width, md->sc_height, golden_nums, 1);
+
+    iterFileClose(file);
+
+    return is_loaded;
+}
+
+bool testGolden(const char * golden_dir, const bool is_update)
+{
+    assert(golden_dir);
+
+    golden_diff_t total_diffs[GOLDEN_KERNELS_NUM] = {};
+    bool is_kernel_failed[GOLDEN_KERNELS_NUM] = {};
+    bool is_passed = true;
+
+    for (size_t view_index = 0; view_index < GOLDEN_VIEWS_NUM; view_index++){
+        const golden_view_t * view = GOLDEN_VIEWS + view_index;
+        const size_t pixels_num = (size_t)view->width * view->height;
+
+        char file_name[256] = {};
+        snprintf(file_name, sizeof(file_name), "%s/%s.mdit", golden_dir, view->name);
+
+        mandelbrot_context_t md = mandelbrotCtor(view->width, view->height);
+        md.center_x = view->center_x;
+        md.center_y = view->center_y;
+        md.scale    = view->plot_width / view->width;
+        md.iter_num = view->iter_num;
+        calculateColorTable(&md);
+
+        // golden frames are rendered by the reference kernel
+        if (is_update){
+            calcMandelbrotNoOptimization(&md);
+
+            if (saveIterFile(file_name, &md))
+                printf("'%s' is updated\n", file_name);
+            else
+                is_passed = false;
+
+            mandelbrotDtor(&md);
+            continue;
+        }
+
+        uint32_t * golden_nums = (uint32_t *)calloc(pixels_num, sizeof(uint32_t));
+        uint32_t * kernel_nums = (uint32_t *)calloc(pixels_num * GOLDEN_KERNELS_NUM, sizeof(uint32_t));
+
+        if (! loadGoldenFrame(file_name, &md, golden_nums)){
+            free(golden_nums);
+            free(kernel_nums);
+            mandelbrotDtor(&md);
+
+            is_passed = false;
+            continue;
+        }
+
+        printf("%s: %ux%u, center = (%f, %f), plot width = %f, iter num = %u\n",
+            view->name, view->width, view->height, view->center_x, view->center_y, view->plot_width, view->iter_num);
+
+        for (size_t kernel_index = 0; kernel_index < GOLDEN_KERNELS_NUM; kernel_index++){
+            const golden_kernel_t * kernel = GOLDEN_KERNELS + kernel_index;
+            uint32_t * nums = kernel_nums + pixels_num * kernel_index;
+
+            memset(md.num_pixels, 0xFF, pixels_num * sizeof(uint32_t));
+
+            if (kernel->calc_func)
+                kernel->calc_func(&md);
+            else
+                kernel->threads_func(&md, kernel->threads_num);
+
+            memcpy(nums, md.num_pixels, pixels_num * sizeof(uint32_t));
+
+            if (kernel->is_distance){
+                for (size_t pixel_index = 0; pixel_index < pixels_num; pixel_index++){
+                    if (md.dist_pixels[pixel_index] == 0 && nums[pixel_index] < md.iter_num)
+                        nums[pixel_index] = GOLDEN_FILLED_PIXEL;
+                }
+            }
+
+            const golden_diff_t diff = compareNums(nums, golden_nums, view->width, view->height);
+            const double mismatch_share = (double)diff.mismatches / pixels_num;
+
+            bool is_ok = diff.unwritten == 0 && mismatch_share <= view->max_mismatch_share
+                      && diff.smooth_mismatches <= view->max_smooth_mismatches;
+
+            size_t base_mismatches = 0;
+            if (kernel->base_index >= 0){
+                const golden_diff_t base_diff = compareNums(nums, kernel_nums + pixels_num * kernel->base_index, view->width, view->height);
+                base_mismatches = base_diff.mismatches + base_diff.unwritten;
+
+                is_ok = is_ok && base_mismatches == 0;
+            }
+
+            printf("    %-24s %7zu mismatches (%6.3lf%%), %4zu off boundary, max deviation = %5u, unwritten = %zu",
+                kernel->name, diff.mismatches, 100. * mismatch_share, diff.smooth_mismatches, diff.max_deviation, diff.unwritten);
+
+            if (kernel->is_distance)
+                printf(", %zu boundary filled", diff.filled);
+
+            if (kernel->base_index >= 0)
+                printf(", %zu differ from %s", base_mismatches, GOLDEN_KERNELS[kernel->base_index].name);
+
+            printf("%s\n", is_ok ? "" : "  <- FAILED");
+
+            golden_diff_t * total = total_diffs + kernel_index;
+            total->mismatches += diff.mismatches;
+            total->unwritten  += diff.unwritten;
+            if (diff.max_deviation > total->max_deviation)
+                total->max_deviation = diff.max_deviation;
+
+            is_kernel_failed[kernel_index] = is_kernel_failed[kernel_index] || ! is_ok;
+            is_passed = is_passed && is_ok;
+        }
+        printf("\n");
+
+        free(golden_nums);
+        free(kernel_nums);
+        mandelbrotDtor(&md);
+    }
+
+    if (is_update)
+        return is_passed;
+
+    is_passed = testEngineJobs() && is_passed;
+
+    releaseTestEngine();
+
+    printf("TOTAL:\n");
+    for (size_t kernel_index = 0; kernel_index < GOLDEN_KERNELS_NUM; kernel_index++){
+        printf("    %-24s %7zu mismatches, max deviation = %5u, unwritten = %zu  %s\n",
+            GOLDEN_KERNELS[kernel_index].name, total_diffs[kernel_index].mismatches,
+            total_diffs[kernel_index].max_deviation, total_diffs[kernel_index].unwritten,
+            is_kernel_failed[kernel_index] ? "FAILED" : "OK");
+    }
+
+    printf("\n%s\n", is_passed ? "ALL KERNELS MATCH GOLDEN FRAMES" : "SOME KERNELS DO NOT MATCH GOLDEN FRAMES");
+
+    return is_passed;
 }
 
 void printOptionsInfo(mandelbrot_context_t * md)
@@ -85,9 +627,7 @@ void printOptionsInfo(mandelbrot_context_t * md)
     printf("-> BURNING_SHIP IS DEFINED\n");
   #endif
 
-  #ifdef AVX_ON
-    printf("-> AVX_ON IS DEFINED\n");
-  #endif
+    printf("-> SIMD backend = %s (compared with %s)\n", simdBackendName(), simd_generic::simdBackendName());
 
     printf("-> intrin pack size = %d\n", INTRIN_PACK_SIZE);
     printf("\n");
@@ -97,3 +637,270 @@ void calcMandelbrot8Threads(mandelbrot_context_t * md)
 {
     calcMandelbrotMultiThread(md, 8);
 }
+
+static void calcMandelbrotGeneric8Threads(mandelbrot_context_t * md)
+{
+    simd_generic::calcMandelbrotMultiThread(md, 8);
+}
+
+void calcMandelbrot8ThreadsColored(mandelbrot_context_t * md)
+{
+    calcMandelbrotMultiThread(md, 8);
+    numsToColor(md);
+}
+
+void calcMandelbrot8ThreadsAntialiased(mandelbrot_context_t * md)
+{
+    calcMandelbrotMultiThread(md, 8);
+    numsToColor(md);
+    antialiasMandelbrot(md, 8);
+}
+
+void probeIterNumOnly(mandelbrot_context_t * md)
+{
+    probeIterNum(md);
+}
+
+void renderEngine8Workers(mandelbrot_context_t * md)
+{
+    render_engine_t * engine = testEngine();
+
+    mandelbrot_view_t view = contextView(md);
+
+    // context buffers are rendered into directly, target does not own them
+    render_target_t target = {
+        .num_pixels   = md->num_pixels,
+        .color_pixels = md->color_pixels,
+        .width        = md->sc_width,
+        .height       = md->sc_height,
+        .capacity     = (size_t)md->sc_width * md->sc_height,
+        .workers_num  = DEFAULT_THREADS_NUM     // bands of the context buffers placed by mandelbrotCtor
+    };
+
+    renderView(engine, &view, &target);
+}
+
+static render_engine_t * testEngine()
+{
+    if (! test_engine)
+        test_engine = renderEngineCtor(8);
+
+    return test_engine;
+}
+
+static void releaseTestEngine()
+{
+    if (! test_engine)
+        return;
+
+    renderEngineDtor(test_engine);
+    test_engine = NULL;
+}
+
+static mandelbrot_view_t contextView(const mandelbrot_context_t * md)
+{
+    assert(md);
+
+    mandelbrot_view_t view = {
+        .center_x = md->center_x,
+        .center_y = md->center_y,
+        .scale    = md->scale,
+        .iter_num = md->iter_num
+    };
+
+    return view;
+}
+
+/// @brief renderEngine8Workers with only 3 workers taking tiles, pixels are left unwritten if the pool is not limited
+static void renderEngine3ActiveWorkers(mandelbrot_context_t * md)
+{
+    assert(md);
+
+    render_engine_t * engine = testEngine();
+
+    renderSetActiveThreads(engine, 3);
+
+    if (renderActiveThreads(engine) == 3)
+        renderEngine8Workers(md);
+
+    renderSetActiveThreads(engine, 8);
+}
+
+typedef struct {
+    render_engine_t * engine;
+    mandelbrot_view_t view;
+    render_target_t target;
+
+    render_status_t status;
+} submitter_task_t;
+
+static void * submitterThread(void * task_ptr)
+{
+    assert(task_ptr);
+
+    submitter_task_t * task = (submitter_task_t *)task_ptr;
+
+    task->status = renderView(task->engine, &task->view, &task->target);
+
+    return NULL;
+}
+
+/// @brief the view is submitted by 4 threads at the same time into their own targets, frame of the first one is
+///        taken as the result, pixels where the others differ from it (or jobs which are not done) are left unwritten
+static void renderEngine4Submitters(mandelbrot_context_t * md)
+{
+    assert(md);
+
+    const size_t SUBMITTERS_NUM = 4;
+    const size_t pixels_num = (size_t)md->sc_width * md->sc_height;
+
+    submitter_task_t tasks[SUBMITTERS_NUM] = {};
+    pthread_t threads[SUBMITTERS_NUM] = {};
+
+    for (size_t task_index = 0; task_index < SUBMITTERS_NUM; task_index++){
+        tasks[task_index].engine = testEngine();
+        tasks[task_index].view   = contextView(md);
+        tasks[task_index].target = renderTargetCtor(md->sc_width, md->sc_height, 8);
+
+        pthread_create(threads + task_index, NULL, submitterThread, tasks + task_index);
+    }
+
+    for (size_t task_index = 0; task_index < SUBMITTERS_NUM; task_index++){
+        pthread_join(threads[task_index], NULL);
+    }
+
+    memcpy(md->num_pixels, tasks[0].target.num_pixels, pixels_num * sizeof(uint32_t));
+
+    for (size_t task_index = 0; task_index < SUBMITTERS_NUM; task_index++){
+        const uint32_t * nums = tasks[task_index].target.num_pixels;
+
+        for (size_t pixel_index = 0; pixel_index < pixels_num; pixel_index++){
+            if (tasks[task_index].status != RENDER_DONE || nums[pixel_index] != md->num_pixels[pixel_index])
+                md->num_pixels[pixel_index] = GOLDEN_UNWRITTEN_PIXEL;
+        }
+
+        renderTargetDtor(&tasks[task_index].target);
+    }
+}
+
+// slow view for jobs which are cancelled while they are rendered: all points are in the main cardioid,
+// so they are iterated to the limit (a tile takes tens of ms for one worker)
+static const mandelbrot_view_t SLOW_VIEW = {-0.2f, 0.0f, 0.1f / 1024, 8192};
+const uint32_t SLOW_FRAME_SIZE = 1024;
+
+/// @brief number of pixels which are still UINT32_MAX in tiles which are (is_done) or are not done (tiles_done is NULL - in all tiles)
+static size_t countUnwritten(const render_target_t * target, const bool * tiles_done, const bool is_done)
+{
+    assert(target);
+
+    size_t unwritten = 0;
+
+    for (uint32_t iy = 0; iy < target->height; iy++){
+        if (tiles_done && tiles_done[iy / ENGINE_TILE_ROWS] != is_done)
+            continue;
+
+        for (uint32_t ix = 0; ix < target->width; ix++){
+            if (target->num_pixels[(size_t)iy * target->width + ix] == UINT32_MAX)
+                unwritten++;
+        }
+    }
+
+    return unwritten;
+}
+
+/// @brief cancels a job after its first tile and destroys an engine with jobs which are not released, prints results
+static bool testEngineJobs()
+{
+    printf("ENGINE JOBS:\n");
+
+    bool is_passed = true;
+
+    // cancelled job: done tiles are not changed anymore, other tiles are not written
+    render_engine_t * engine = renderEngineCtor(2);
+    renderSetActiveThreads(engine, 1);
+
+    render_target_t target = renderTargetCtor(SLOW_FRAME_SIZE, SLOW_FRAME_SIZE, 2);
+    memset(target.num_pixels, 0xFF, (size_t)SLOW_FRAME_SIZE * SLOW_FRAME_SIZE * sizeof(uint32_t));
+
+    render_job_t * job = renderSubmit(engine, &SLOW_VIEW, &target);
+    const uint32_t tiles_num = renderTilesNum(job);
+
+    bool * tiles_done  = (bool *)calloc(tiles_num, sizeof(bool));
+    uint32_t * done_nums = (uint32_t *)calloc((size_t)SLOW_FRAME_SIZE * SLOW_FRAME_SIZE, sizeof(uint32_t));
+
+    const struct timespec poll_period = {0, 1000000};
+    while (renderDoneTiles(job, tiles_done) == 0)
+        nanosleep(&poll_period, NULL);
+
+    memcpy(done_nums, target.num_pixels, (size_t)SLOW_FRAME_SIZE * SLOW_FRAME_SIZE * sizeof(uint32_t));
+
+    renderCancel(job);
+    const render_status_t status = renderWait(job);
+
+    size_t changed = 0;
+    for (uint32_t iy = 0; iy < SLOW_FRAME_SIZE; iy++){
+        if (tiles_done[iy / ENGINE_TILE_ROWS] && memcmp(done_nums + (size_t)iy * SLOW_FRAME_SIZE, target.num_pixels + (size_t)iy * SLOW_FRAME_SIZE,
+                                                       SLOW_FRAME_SIZE * sizeof(uint32_t)) != 0)
+            changed++;
+    }
+
+    const uint32_t done_num = renderDoneTiles(job, tiles_done);
+    const size_t unwritten_done = countUnwritten(&target, tiles_done, true);
+    const size_t written_rest   = (size_t)(tiles_num - done_num) * ENGINE_TILE_ROWS * SLOW_FRAME_SIZE - countUnwritten(&target, tiles_done, false);
+
+    bool is_ok = status == RENDER_CANCELLED && done_num < tiles_num && changed == 0 && unwritten_done == 0 && written_rest == 0;
+    is_passed = is_passed && is_ok;
+
+    printf("    %-24s %u of %u tiles done, %zu rows of done tiles changed, %zu pixels written out of them%s\n",
+        "cancel", done_num, tiles_num, changed, written_rest, is_ok ? "" : "  <- FAILED");
+
+    renderRelease(job);
+    renderTargetDtor(&target);
+    free(tiles_done);
+    free(done_nums);
+
+    // destroying engine with queued jobs: they are cancelled and freed, it takes only running tiles
+    const size_t JOBS_NUM = 3;
+    render_target_t targets[JOBS_NUM] = {};
+
+    for (size_t job_index = 0; job_index < JOBS_NUM; job_index++){
+        targets[job_index] = renderTargetCtor(SLOW_FRAME_SIZE, SLOW_FRAME_SIZE, 2);
+        memset(targets[job_index].num_pixels, 0xFF, (size_t)SLOW_FRAME_SIZE * SLOW_FRAME_SIZE * sizeof(uint32_t));
+    }
+
+    renderSetActiveThreads(engine, 2);
+
+    for (size_t job_index = 0; job_index < JOBS_NUM; job_index++){
+        renderSubmit(engine, &SLOW_VIEW, targets + job_index);
+    }
+
+    // workers are in the middle of their tiles when the engine is destroyed
+    const struct timespec run_time = {0, 20000000};
+    nanosleep(&run_time, NULL);
+
+    struct timespec dtor_start = {};
+    struct timespec dtor_end   = {};
+
+    clock_gettime(CLOCK_MONOTONIC, &dtor_start);
+    renderEngineDtor(engine);
+    clock_gettime(CLOCK_MONOTONIC, &dtor_end);
+
+    const double dtor_time = 1000. * (dtor_end.tv_sec - dtor_start.tv_sec) + (dtor_end.tv_nsec - dtor_start.tv_nsec) / 1e6;
+
+    size_t unwritten = 0;
+    for (size_t job_index = 0; job_index < JOBS_NUM; job_index++){
+        unwritten += countUnwritten(targets + job_index, NULL, false);
+        renderTargetDtor(targets + job_index);
+    }
+
+    const size_t pixels_num = JOBS_NUM * SLOW_FRAME_SIZE * SLOW_FRAME_SIZE;
+
+    is_ok = unwritten > 0;
+    is_passed = is_passed && is_ok;
+
+    printf("    %-24s %zu jobs are freed in %.1lf ms, %.1lf%% of their pixels are rendered%s\n",
+        "engine destructor", JOBS_NUM, dtor_time, 100. * (pixels_num - unwritten) / pixels_num, is_ok ? "" : "  <- FAILED");
+    printf("\n");
+
+    return is_passed;
+}
@@ -1,17 +1,112 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <time.h>
 #include <assert.h>
 
 #include <SFML/Graphics.hpp>
 
 #include "mandelbrot.h"
+#include "antialiasing.h"
+#include "iter_probe.h"
+#include "buddhabrot.h"
+#include "iter_file.h"
+#include "mandelbrot_engine.h"
 
 const double   POS_CHANGE_COEF = 0.1;
 const double SCALE_CHANGE_COEF = 1.1;
 const uint32_t ITER_NUM_DELTA = 128;
 
-const char * POS_FILE_NAME = "position.txt";
+// zoom is animated: every second scale goes through this share (in exp) of the remaining zoom,
+// the point under the cursor stays in place
+const double ZOOM_RATE = 12.;
+const double ZOOM_END_PRECISION = 1e-3;
+
+const size_t WINDOW_THREADS_NUM = DEFAULT_THREADS_NUM;
+
+const unsigned WINDOW_FRAME_RATE = 60;
+// while nothing changes the window is only redrawn, it does not need the full frame rate
+const unsigned WINDOW_IDLE_FRAME_RATE = 20;
+
+// frame rate governor: frames are rendered only when the view changes, number of workers and resolution follow
+// the time of the previous rendered frame
+const double GOVERNOR_BUDGET_MS = 1000. / WINDOW_FRAME_RATE;
+// frame rendered faster than this share of the budget gives away a worker (or restores resolution)
+const double GOVERNOR_LOW_LOAD = 0.5;
+// frames are rendered in down to 1/GOVERNOR_MAX_RES_DIVISOR of the window size while the view is changing
+const uint32_t GOVERNOR_MAX_RES_DIVISOR = 4;
+// preview size is doubled only if the frame of 4 times more pixels is expected to take less than this share
+// of the budget, otherwise the next frame would halve it again
+const double GOVERNOR_RES_RESTORE_LOAD = 0.8;
+
+const size_t WINDOW_BUDDHA_SAMPLES = 2000000;
+
+typedef struct {
+    bool antialiasing;
+    bool distance;
+    bool auto_iter_num;
+    bool buddhabrot;
+} window_options_t;
+
+typedef struct {
+    bool is_on;
+
+    size_t threads_num;         // workers for the next frame
+    uint32_t res_divisor;       // frames rendered during interaction are this number of times smaller than the window
+
+    bool is_idle;
+
+    // last window frame and last rendered frame, in ms; cpu time is of all threads of the process
+    double frame_time;
+    double frame_cpu_time;
+    double render_time;
+    double render_cpu_time;
+
+    size_t frames_num;
+    size_t idle_frames_num;
+    size_t rendered_frames_num;
+    size_t cancelled_frames_num;    // frames of the stopped view which were dropped when it changed again
+    double total_time;
+    double total_cpu_time;
+    double total_render_time;
+} frame_governor_t;
+
+typedef struct {
+    double zoom_left;       // log of the remaining scale change
+    int anchor_x;           // pixel under the cursor
+    int anchor_y;
+} zoom_state_t;
+
+typedef enum {
+    KEY_NO_RENDER = 0,      // nothing is rendered again (saving, unknown keys)
+    KEY_VIEW,               // navigation: the view is changing
+    KEY_OPTIONS             // the same view is rendered again with other options or iteration limit
+} key_action_t;
+
+// plain escape time frames are rendered by the engine in background: the window shows the last finished frame
+// reprojected to the current view and finished tiles of the next one over it, so it does not wait for the renderer
+typedef struct {
+    render_engine_t * engine;
+    render_target_t targets[2];
+
+    render_target_t * done_target;
+    mandelbrot_view_t done_view;
+    bool has_done;
+
+    render_target_t * job_target;
+    mandelbrot_view_t job_view;
+    render_job_t * job;
+    struct timespec job_start;
+    double job_cpu_start;
+    bool is_job_interactive;
+
+    bool * tiles_done;
+    int32_t * src_columns;
+} async_frame_t;
+
+const char * POS_FILE_NAME  = "position.txt";
+const char * ITER_FILE_NAME = "frame.mdit";
 const char * POS_RECORD_FORMAT =
         "center_x   = %lf\n"
         "center_y   = %lf\n"
@@ -29,7 +124,37 @@ do {
     printf("%lf ms", calc_time);                                                                              \
 } while(0)
 
-static void handlePressedKey(sf::Keyboard::Key pressed_key_code, mandelbrot_context_t * md);
+static key_action_t handlePressedKey(sf::Keyboard::Key pressed_key_code, mandelbrot_context_t * md, window_options_t * options);
+
+static void renderEscapeTimeFrame(mandelbrot_context_t * md, window_options_t * options, const size_t threads_num);
+
+static void renderBuddhabrotFrame(mandelbrot_context_t * md);
+
+static bool isAsyncMode(const window_options_t * options);
+
+static void asyncFrameCtor(async_frame_t * frame, const uint32_t width, const uint32_t height);
+
+static void asyncFrameDtor(async_frame_t * frame);
+
+static bool drawAsyncFrame(async_frame_t * frame, mandelbrot_context_t * md, const window_options_t * options,
+                           frame_governor_t * governor, const bool is_view_changed, const bool is_options_changed);
+
+static void reprojectFrame(const mandelbrot_view_t * dest_view, uint32_t * dest, const uint32_t width, const uint32_t height,
+                           const mandelbrot_view_t * src_view, const uint32_t * src, const uint32_t src_width, const uint32_t src_height,
+                           const bool * tiles_done, int32_t * src_columns);
+
+static double cpuTimeMs();
+
+static void governFrame(frame_governor_t * governor, const double render_time, const double render_cpu_time,
+                        const bool is_interactive, const bool is_resolution_scaled);
+
+static void printGovernorStats(const frame_governor_t * governor);
+
+static void startZoom(zoom_state_t * zoom, const sf::Event::MouseWheelScrollEvent * scroll);
+
+static bool updateZoom(zoom_state_t * zoom, mandelbrot_context_t * md, const double frame_time);
+
+static void saveShownFrame(const mandelbrot_context_t * md, const async_frame_t * frame, const window_options_t * options);
 
 static void savePositionToFile(const char * file_name, mandelbrot_context_t * md);
 
@@ -39,7 +164,7 @@ void runWindow(const uint32_t width, const uint32_t height)
 {
     sf::RenderWindow window(sf::VideoMode(width, height), "Mandelbrot");
     window.setVerticalSyncEnabled(true);
-    window.setFramerateLimit(60);
+    window.setFramerateLimit(WINDOW_FRAME_RATE);
 
     sf::Texture mandelbrot_texture;
     mandelbrot_texture.create(width, height);
@@ -49,6 +174,25 @@ void runWindow(const uint32_t width, const uint32_t height)
 
     mandelbrot_context_t md = mandelbrotCtor(width, height);
 
+    window_options_t options = {};
+
+    zoom_state_t zoom = {};
+
+    async_frame_t async_frame = {};
+    asyncFrameCtor(&async_frame, width, height);
+
+    frame_governor_t governor = {};
+    governor.is_on       = true;
+    governor.threads_num = WINDOW_THREADS_NUM;
+    governor.res_divisor = 1;
+
+    bool is_view_changed    = false;
+    bool is_options_changed = true;
+
+    struct timespec last_frame = {};
+    clock_gettime(CLOCK_MONOTONIC, &last_frame);
+    double last_frame_cpu = cpuTimeMs();
+
     while (window.isOpen()) {
         sf::Event event;
 
@@ -58,31 +202,95 @@ void runWindow(const uint32_t width, const uint32_t height)
             }
 
             if (event.type == sf::Event::KeyPressed){
-                handlePressedKey(event.key.code, &md);
+                if (event.key.code == sf::Keyboard::F7)
+                    saveShownFrame(&md, &async_frame, &options);
+
+                if (event.key.code == sf::Keyboard::F8)
+                    printGovernorStats(&governor);
+
+                if (event.key.code == sf::Keyboard::G){
+                    governor.is_on = ! governor.is_on;
+                    printf("frame rate governor is %s\n", governor.is_on ? "on" : "off");
+                }
+
+                key_action_t key_action = handlePressedKey(event.key.code, &md, &options);
+
+                is_view_changed    = is_view_changed    || key_action == KEY_VIEW;
+                is_options_changed = is_options_changed || key_action == KEY_OPTIONS;
             }
 
             if (event.type == sf::Event::MouseWheelScrolled){
-                md.scale = (event.mouseWheelScroll.delta > 0) ?
-                    md.scale / SCALE_CHANGE_COEF :
-                    md.scale * SCALE_CHANGE_COEF;
+                startZoom(&zoom, &event.mouseWheelScroll);
             }
         }
 
+        struct timespec cur_frame = {};
+        clock_gettime(CLOCK_MONOTONIC, &cur_frame);
+        const double frame_time = (cur_frame.tv_sec - last_frame.tv_sec) + (cur_frame.tv_nsec - last_frame.tv_nsec) / 1e9;
+        last_frame = cur_frame;
+
+        const double cur_frame_cpu = cpuTimeMs();
+
+        governor.frame_time     = 1000. * frame_time;
+        governor.frame_cpu_time = cur_frame_cpu - last_frame_cpu;
+        governor.frames_num++;
+        governor.total_time     += governor.frame_time;
+        governor.total_cpu_time += governor.frame_cpu_time;
+        last_frame_cpu = cur_frame_cpu;
+
+        if (updateZoom(&zoom, &md, frame_time))
+            is_view_changed = true;
+
         /***************************/
-        printf("one frame calc time = ");
-        PRINT_TIME(calcMandelbrotMultiThread(&md, 8));
-        // PRINT_TIME(calcMandelbrotConveyor(&md));
-        // PRINT_TIME(calcMandelbrot(&md));
-        // PRINT_TIME(calcMandelbrotGCCoptimized(&md));
-        // PRINT_TIME(calcMandelbrotNoOptimization(&md));
-        printf("\n");
-
-        printf("one frame coloring time = ");
-        PRINT_TIME(numsToColor(&md));
-        printf("\n");
+        bool is_frame_changed = false;
+        bool is_iter_num_refined = false;
+
+        if (options.buddhabrot){
+            // orbit density takes seconds, so it is rendered only once for every view
+            if (is_view_changed || is_options_changed){
+                renderBuddhabrotFrame(&md);
+                is_frame_changed = true;
+            }
+        }
+        else if (isAsyncMode(&options))
+            is_frame_changed = drawAsyncFrame(&async_frame, &md, &options, &governor, is_view_changed, is_options_changed);
+        else if (is_view_changed || is_options_changed){
+            const double render_start     = cpuTimeMs();
+            struct timespec render_wall_start = {};
+            struct timespec render_wall_end   = {};
+
+            const uint32_t iter_num = md.iter_num;
+
+            clock_gettime(CLOCK_MONOTONIC, &render_wall_start);
+            // frame of the stopped view gets all workers, it is rendered before the next events are handled
+            renderEscapeTimeFrame(&md, &options, is_view_changed ? governor.threads_num : WINDOW_THREADS_NUM);
+            clock_gettime(CLOCK_MONOTONIC, &render_wall_end);
+
+            // limit estimated by distances is applied in the next frame
+            is_iter_num_refined = md.iter_num != iter_num;
+
+            const double render_time = 1000. * (render_wall_end.tv_sec - render_wall_start.tv_sec)
+                                     + (render_wall_end.tv_nsec - render_wall_start.tv_nsec) / 1e6;
+
+            // antialiasing and distance estimation take the whole frame, so only the number of workers is changed
+            governFrame(&governor, render_time, cpuTimeMs() - render_start, is_view_changed, false);
+            is_frame_changed = true;
+        }
+
+        is_view_changed    = false;
+        is_options_changed = is_iter_num_refined;
         /***************************/
 
-        mandelbrot_texture.update((uint8_t *)md.color_pixels);
+        // nothing is rendered for an unchanged view, the window is only redrawn at a lower rate
+        if (governor.is_idle != ! is_frame_changed){
+            governor.is_idle = ! is_frame_changed;
+            window.setFramerateLimit(governor.is_idle ? WINDOW_IDLE_FRAME_RATE : WINDOW_FRAME_RATE);
+        }
+
+        if (governor.is_idle)
+            governor.idle_frames_num++;
+        else
+            mandelbrot_texture.update((uint8_t *)md.color_pixels);
 
         window.clear();
 
@@ -90,15 +298,418 @@ void runWindow(const uint32_t width, const uint32_t height)
 
         window.display();
     }
+    printGovernorStats(&governor);
+
+    asyncFrameDtor(&async_frame);
     mandelbrotDtor(&md);
 }
 
-static void handlePressedKey(sf::Keyboard::Key pressed_key_code, mandelbrot_context_t * md)
+static void renderEscapeTimeFrame(mandelbrot_context_t * md, window_options_t * options, const size_t threads_num)
+{
+    assert(md);
+    assert(options);
+
+    // distance estimation chooses the limit by itself after the frame
+    if (options->auto_iter_num && ! options->distance){
+        iter_probe_result_t probe = probeIterNum(md);
+        md->iter_num = probe.iter_num;
+
+        printf("iter num = %u (probe time = %lf ms, %zu probe calcs)\n", probe.iter_num, probe.time, probe.probe_calcs);
+    }
+
+    printf("one frame calc time = ");
+    if (options->distance)
+        PRINT_TIME(calcMandelbrotDistanceMultiThread(md, threads_num));
+    else
+        PRINT_TIME(calcMandelbrotMultiThread(md, threads_num));
+    // PRINT_TIME(calcMandelbrotConveyor(md));
+    // PRINT_TIME(calcMandelbrot(md));
+    // PRINT_TIME(calcMandelbrotGCCoptimized(md));
+    // PRINT_TIME(calcMandelbrotNoOptimization(md));
+    printf("\n");
+
+    printf("one frame coloring time = ");
+    if (options->distance)
+        PRINT_TIME(distToColor(md));
+    else
+        PRINT_TIME(numsToColor(md));
+    printf("\n");
+
+    // subsamples are colored by escape numbers only
+    if (options->antialiasing && ! options->distance){
+        size_t edge_num = 0;
+        printf("one frame antialiasing time = ");
+        PRINT_TIME(edge_num = antialiasMandelbrot(md, threads_num));
+        printf(" (%.1lf%% edge pixels)\n", 100. * edge_num / ((double)md->sc_width * md->sc_height));
+    }
+
+    if (options->auto_iter_num && options->distance){
+        md->iter_num = estimateIterNumByDistance(md);
+        printf("iter num = %u\n", md->iter_num);
+    }
+}
+
+static void renderBuddhabrotFrame(mandelbrot_context_t * md)
+{
+    assert(md);
+
+    buddhabrot_params_t params = {
+        .samples_num   = WINDOW_BUDDHA_SAMPLES,
+        .threads_num   = WINDOW_THREADS_NUM,
+        .is_nebula     = true,
+        .is_metropolis = true
+    };
+
+    buddhabrot_stats_t stats = renderBuddhabrot(md, &params);
+
+    printf("nebulabrot render time = %lf ms (%.3lf Morbits/s)\n", stats.time, stats.orbits_per_sec / 1e6);
+}
+
+static bool isAsyncMode(const window_options_t * options)
+{
+    assert(options);
+
+    // antialiasing and distance estimation work with the whole frame
+    return ! options->buddhabrot && ! options->antialiasing && ! options->distance;
+}
+
+static void asyncFrameCtor(async_frame_t * frame, const uint32_t width, const uint32_t height)
+{
+    assert(frame);
+
+    frame->engine = renderEngineCtor(WINDOW_THREADS_NUM);
+
+    frame->targets[0] = renderTargetCtor(width, height, WINDOW_THREADS_NUM);
+    frame->targets[1] = renderTargetCtor(width, height, WINDOW_THREADS_NUM);
+
+    frame->done_target = frame->targets;
+    frame->job_target  = frame->targets + 1;
+
+    frame->tiles_done  = (bool    *)calloc((height + ENGINE_TILE_ROWS - 1) / ENGINE_TILE_ROWS, sizeof(bool));
+    frame->src_columns = (int32_t *)calloc(width, sizeof(int32_t));
+}
+
+static void asyncFrameDtor(async_frame_t * frame)
+{
+    assert(frame);
+
+    if (frame->job){
+        renderCancel(frame->job);
+        renderRelease(frame->job);
+    }
+
+    renderEngineDtor(frame->engine);
+
+    renderTargetDtor(frame->targets);
+    renderTargetDtor(frame->targets + 1);
+
+    free(frame->tiles_done);
+    free(frame->src_columns);
+}
+
+/// @brief takes finished frame from the engine, cancels the frame of the stopped view if it is changing again,
+///        starts the next one if the view has changed and composes the shown frame in md->color_pixels;
+///        returns false if the shown frame is not changed
+static bool drawAsyncFrame(async_frame_t * frame, mandelbrot_context_t * md, const window_options_t * options,
+                           frame_governor_t * governor, const bool is_view_changed, const bool is_options_changed)
+{
+    assert(frame);
+    assert(md);
+    assert(options);
+    assert(governor);
+
+    bool is_frame_changed = is_view_changed || is_options_changed || frame->job;
+
+    if (frame->job && renderStatus(frame->job) != RENDER_IN_PROGRESS){
+        renderRelease(frame->job);
+        frame->job = NULL;
+
+        struct timespec job_end = {};
+        clock_gettime(CLOCK_MONOTONIC, &job_end);
+
+        governFrame(governor,
+            1000. * (job_end.tv_sec - frame->job_start.tv_sec) + (job_end.tv_nsec - frame->job_start.tv_nsec) / 1e6,
+            cpuTimeMs() - frame->job_cpu_start, frame->is_job_interactive, true);
+
+        render_target_t * done_target = frame->job_target;
+        frame->job_target  = frame->done_target;
+        frame->done_target = done_target;
+
+        frame->done_view = frame->job_view;
+        frame->has_done  = true;
+    }
+
+    // full size frame of the stopped view can take seconds, it is dropped as soon as the view changes again,
+    // so that the preview of the new view is not waiting for it (the last finished frame stays shown)
+    if (frame->job && is_view_changed && ! frame->is_job_interactive){
+        renderCancel(frame->job);
+        renderRelease(frame->job);
+        frame->job = NULL;
+
+        // workers of the still frame are given back to the governor at once, even if no preview is started
+        renderSetActiveThreads(frame->engine, governor->threads_num);
+        governor->cancelled_frames_num++;
+    }
+
+    // frames rendered in lower resolution have greater scale, so they are rendered again when the view stops
+    const bool is_done_shown = frame->has_done && frame->done_view.center_x == md->center_x && frame->done_view.center_y == md->center_y
+                            && frame->done_view.scale == md->scale && frame->done_view.iter_num == md->iter_num;
+
+    // only one frame is rendered at a time, during animation frames are rendered as fast as the engine can
+    if (! frame->job && ! is_done_shown){
+        if (options->auto_iter_num){
+            iter_probe_result_t probe = probeIterNum(md);
+            md->iter_num = probe.iter_num;
+
+            printf("iter num = %u (probe time = %lf ms, %zu probe calcs)\n", probe.iter_num, probe.time, probe.probe_calcs);
+        }
+
+        // the view is still changing, frame is only a preview
+        const uint32_t res_divisor = is_view_changed ? governor->res_divisor : 1;
+
+        renderTargetResize(frame->job_target, (md->sc_width  + res_divisor - 1) / res_divisor,
+                                              (md->sc_height + res_divisor - 1) / res_divisor);
+
+        frame->job_view.center_x = md->center_x;
+        frame->job_view.center_y = md->center_y;
+        frame->job_view.scale    = md->scale * res_divisor;
+        frame->job_view.iter_num = md->iter_num;
+
+        frame->is_job_interactive = is_view_changed;
+
+        // frame of the stopped view is rendered once in full size, it gets all workers
+        renderSetActiveThreads(frame->engine, is_view_changed ? governor->threads_num : WINDOW_THREADS_NUM);
+
+        clock_gettime(CLOCK_MONOTONIC, &frame->job_start);
+        frame->job_cpu_start = cpuTimeMs();
+        frame->job = renderSubmit(frame->engine, &frame->job_view, frame->job_target);
+
+        is_frame_changed = true;
+    }
+
+    if (! is_frame_changed)
+        return false;
+
+    const mandelbrot_view_t shown_view = {md->center_x, md->center_y, md->scale, md->iter_num};
+
+    if (frame->has_done)
+        reprojectFrame(&shown_view, md->color_pixels, md->sc_width, md->sc_height,
+                       &frame->done_view, frame->done_target->color_pixels, frame->done_target->width, frame->done_target->height,
+                       NULL, frame->src_columns);
+    else
+        memset(md->color_pixels, 0, (size_t)md->sc_width * md->sc_height * sizeof(uint32_t));
+
+    if (frame->job && renderDoneTiles(frame->job, frame->tiles_done) > 0)
+        reprojectFrame(&shown_view, md->color_pixels, md->sc_width, md->sc_height,
+                       &frame->job_view, frame->job_target->color_pixels, frame->job_target->width, frame->job_target->height,
+                       frame->tiles_done, frame->src_columns);
+
+    return true;
+}
+
+/// @brief draws src frame of src_view into dest frame of dest_view (nearest pixels), pixels out of src are black;
+///        if tiles_done is not NULL, only rows of finished tiles are taken and other pixels of dest are left as they are
+static void reprojectFrame(const mandelbrot_view_t * dest_view, uint32_t * dest, const uint32_t width, const uint32_t height,
+                           const mandelbrot_view_t * src_view, const uint32_t * src, const uint32_t src_width, const uint32_t src_height,
+                           const bool * tiles_done, int32_t * src_columns)
+{
+    assert(dest_view);
+    assert(dest);
+    assert(src_view);
+    assert(src);
+    assert(src_columns);
+
+    // pixel i of the view is the point center + (i - size / 2) * scale
+    const double scale_coef   = (double)dest_view->scale / src_view->scale;
+    const double column_shift = ((double)dest_view->center_x - src_view->center_x) / src_view->scale + src_width  / 2. - width  / 2. * scale_coef;
+    const double row_shift    = ((double)dest_view->center_y - src_view->center_y) / src_view->scale + src_height / 2. - height / 2. * scale_coef;
+
+    for (uint32_t ix = 0; ix < width; ix++){
+        const double src_x = floor(column_shift + ix * scale_coef + 0.5);
+
+        src_columns[ix] = (src_x >= 0 && src_x < src_width) ? (int32_t)src_x : -1;
+    }
+
+    for (uint32_t iy = 0; iy < height; iy++){
+        uint32_t * dest_row = dest + (size_t)iy * width;
+
+        const double src_y = floor(row_shift + iy * scale_coef + 0.5);
+        const bool is_row_in_src = src_y >= 0 && src_y < src_height;
+
+        if (tiles_done && (! is_row_in_src || ! tiles_done[(uint32_t)src_y / ENGINE_TILE_ROWS]))
+            continue;
+
+        if (! is_row_in_src){
+            memset(dest_row, 0, width * sizeof(uint32_t));
+            continue;
+        }
+
+        const uint32_t * src_row = src + (uint32_t)src_y * src_width;
+
+        for (uint32_t ix = 0; ix < width; ix++){
+            if (src_columns[ix] >= 0)
+                dest_row[ix] = src_row[src_columns[ix]];
+            else if (! tiles_done)
+                dest_row[ix] = 0;
+        }
+    }
+}
+
+static double cpuTimeMs()
 {
+    struct timespec cpu_time = {};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_time);
+
+    return 1000. * cpu_time.tv_sec + cpu_time.tv_nsec / 1e6;
+}
+
+/// @brief takes times of the rendered frame and chooses workers and resolution for the next one:
+///        frames of the changing view well under the budget give away workers (or restore resolution), over the budget
+///        they take workers back (and then lower resolution); frames of the stopped view are rendered with all workers
+///        in full size, so they do not change anything
+static void governFrame(frame_governor_t * governor, const double render_time, const double render_cpu_time,
+                        const bool is_interactive, const bool is_resolution_scaled)
+{
+    assert(governor);
+
+    governor->render_time     = render_time;
+    governor->render_cpu_time = render_cpu_time;
+    governor->rendered_frames_num++;
+    governor->total_render_time += render_time;
+
+    printf("one frame render time = %lf ms (cpu time = %lf ms), %zu workers", render_time, render_cpu_time,
+           is_interactive ? governor->threads_num : WINDOW_THREADS_NUM);
+    if (is_interactive && is_resolution_scaled && governor->res_divisor > 1)
+        printf(", preview of 1/%u size", governor->res_divisor);
+    printf("\n");
+
+    if (! governor->is_on){
+        governor->threads_num = WINDOW_THREADS_NUM;
+        governor->res_divisor = 1;
+        return;
+    }
+
+    if (! is_interactive)
+        return;
+
+    if (render_time > GOVERNOR_BUDGET_MS){
+        if (governor->threads_num < WINDOW_THREADS_NUM)
+            governor->threads_num = (2 * governor->threads_num < WINDOW_THREADS_NUM) ? 2 * governor->threads_num : WINDOW_THREADS_NUM;
+        else if (is_resolution_scaled && governor->res_divisor < GOVERNOR_MAX_RES_DIVISOR)
+            governor->res_divisor *= 2;
+    }
+    else if (render_time < GOVERNOR_BUDGET_MS * GOVERNOR_LOW_LOAD){
+        if (governor->res_divisor > 1){
+            if (4 * render_time < GOVERNOR_BUDGET_MS * GOVERNOR_RES_RESTORE_LOAD)
+                governor->res_divisor /= 2;
+        }
+        else if (governor->threads_num > 1)
+            governor->threads_num--;
+    }
+}
+
+static void printGovernorStats(const frame_governor_t * governor)
+{
+    assert(governor);
+
+    const double total_time = (governor->total_time > 0) ? governor->total_time : 1;
+    const size_t frames_num = (governor->frames_num > 0) ? governor->frames_num : 1;
+
+    printf("----------FRAMES----------\n");
+    printf("-> governor         = %s\n", governor->is_on ? "on" : "off");
+    printf("-> workers          = %zu of %zu\n", governor->threads_num, WINDOW_THREADS_NUM);
+    printf("-> preview size     = 1/%u\n", governor->res_divisor);
+    printf("-> window frames    = %zu (%zu idle)\n", governor->frames_num, governor->idle_frames_num);
+    printf("-> rendered frames  = %zu (and %zu cancelled)\n", governor->rendered_frames_num, governor->cancelled_frames_num);
+    printf("-> last frame       = %lf ms (cpu time = %lf ms)\n", governor->frame_time, governor->frame_cpu_time);
+    printf("-> last render      = %lf ms (cpu time = %lf ms)\n", governor->render_time, governor->render_cpu_time);
+    printf("-> mean frame time  = %lf ms\n", governor->total_time / frames_num);
+    printf("-> mean render time = %lf ms\n",
+        (governor->rendered_frames_num > 0) ? governor->total_render_time / governor->rendered_frames_num : 0.);
+    printf("-> mean cpu time    = %lf ms per frame (%.1lf%% of one core)\n",
+        governor->total_cpu_time / frames_num, 100. * governor->total_cpu_time / total_time);
+    printf("\n");
+}
+
+static void startZoom(zoom_state_t * zoom, const sf::Event::MouseWheelScrollEvent * scroll)
+{
+    assert(zoom);
+    assert(scroll);
+
+    zoom->zoom_left -= scroll->delta * log(SCALE_CHANGE_COEF);
+
+    zoom->anchor_x = scroll->x;
+    zoom->anchor_y = scroll->y;
+}
+
+/// @brief makes the next step of animated zoom, returns true if the view has changed
+static bool updateZoom(zoom_state_t * zoom, mandelbrot_context_t * md, const double frame_time)
+{
+    assert(zoom);
     assert(md);
 
+    if (zoom->zoom_left == 0)
+        return false;
+
+    double zoom_step = zoom->zoom_left * (1 - exp(-ZOOM_RATE * frame_time));
+
+    if (fabs(zoom->zoom_left - zoom_step) < ZOOM_END_PRECISION)
+        zoom_step = zoom->zoom_left;
+
+    zoom->zoom_left -= zoom_step;
+
+    // point under the anchor pixel stays in place
+    const double anchor_dx = zoom->anchor_x - md->sc_width  / 2.;
+    const double anchor_dy = zoom->anchor_y - md->sc_height / 2.;
+
+    const double anchor_x = md->center_x + anchor_dx * md->scale;
+    const double anchor_y = md->center_y + anchor_dy * md->scale;
+
+    md->scale = md->scale * exp(zoom_step);
+
+    md->center_x = anchor_x - anchor_dx * md->scale;
+    md->center_y = anchor_y - anchor_dy * md->scale;
+
+    return true;
+}
+
+/// @brief saves iteration data of the frame in the window (in background mode it is the last finished frame)
+static void saveShownFrame(const mandelbrot_context_t * md, const async_frame_t * frame, const window_options_t * options)
+{
+    assert(md);
+    assert(frame);
+    assert(options);
+
+    if (! isAsyncMode(options)){
+        saveIterFile(ITER_FILE_NAME, md);
+        return;
+    }
+
+    if (! frame->has_done)
+        return;
+
+    mandelbrot_context_t done_md = *md;
+
+    done_md.num_pixels = frame->done_target->num_pixels;
+    done_md.sc_width   = frame->done_target->width;
+    done_md.sc_height  = frame->done_target->height;
+    done_md.center_x   = frame->done_view.center_x;
+    done_md.center_y   = frame->done_view.center_y;
+    done_md.scale      = frame->done_view.scale;
+    done_md.iter_num   = frame->done_view.iter_num;
+
+    saveIterFile(ITER_FILE_NAME, &done_md);
+}
+
+static key_action_t handlePressedKey(sf::Keyboard::Key pressed_key_code, mandelbrot_context_t * md, window_options_t * options)
+{
+    assert(md);
+    assert(options);
+
     float step = md->sc_width * md->scale * POS_CHANGE_COEF;
 
+    key_action_t key_action = KEY_VIEW;
+
     switch(pressed_key_code){
         case sf::Keyboard::Escape:
             md->center_x = DEFAULT_CENTER_X;
@@ -109,6 +720,7 @@ static void handlePressedKey(sf::Keyboard::Key pressed_key_code, mandelbrot_cont
 
         case sf::Keyboard::F6:
             savePositionToFile(POS_FILE_NAME, md);
+            key_action = KEY_NO_RENDER;
             break;
 
         case sf::Keyboard::F9:
@@ -132,17 +744,47 @@ static void handlePressedKey(sf::Keyboard::Key pressed_key_code, mandelbrot_cont
             break;
 
         case sf::Keyboard::Z:
+            key_action = KEY_OPTIONS;
+            options->auto_iter_num = false;
             if (md->iter_num > ITER_NUM_DELTA)
                 md->iter_num -= ITER_NUM_DELTA;
             break;
 
         case sf::Keyboard::X:
+            key_action = KEY_OPTIONS;
+            options->auto_iter_num = false;
             md->iter_num += ITER_NUM_DELTA;
             break;
 
+        case sf::Keyboard::I:
+            options->auto_iter_num = ! options->auto_iter_num;
+            key_action = KEY_OPTIONS;
+            break;
+
+        case sf::Keyboard::E:
+            options->distance = ! options->distance;
+            key_action = KEY_OPTIONS;
+            break;
+
+        case sf::Keyboard::B:
+            options->buddhabrot = ! options->buddhabrot;
+            key_action = KEY_OPTIONS;
+            break;
+
+        case sf::Keyboard::Q:
+            options->antialiasing = ! options->antialiasing;
+            key_action = KEY_OPTIONS;
+            break;
+
         default:
+            key_action = KEY_NO_RENDER;
             break;
     }
+
+    if ((pressed_key_code == sf::Keyboard::Q || pressed_key_code == sf::Keyboard::E) && options->antialiasing && options->distance)
+        printf("antialiasing is not applied in distance estimation mode\n");
+
+    return key_action;
 }
 
 static void savePositionToFile(const char * file_name, mandelbrot_context_t * md)